@@ -19,7 +19,23 @@ SOURCES += main.cpp\
     variable.cpp \
     numericalterm.cpp \
     renderarea.cpp \
-    functionedit.cpp
+    functionedit.cpp \
+    compiledterm.cpp \
+    batchkernels.cpp \
+    polynomial.cpp \
+    jitterm.cpp \
+    termtable.cpp \
+    termarena.cpp \
+    interval.cpp \
+    stdecomposition.cpp \
+    benchmark.cpp \
+    fixeddegree.cpp \
+    gridevaluator.cpp \
+    factorization.cpp \
+    polynomialfile.cpp \
+    compiledfunction.cpp \
+    threadpool.cpp \
+    edgesamplestore.cpp
 
 HEADERS  += mainwindow.h \
     binaryop.h \
@@ -27,7 +43,33 @@ HEADERS  += mainwindow.h \
     variable.h \
     numericalterm.h \
     renderarea.h \
-    functionedit.h
+    functionedit.h \
+    compiledterm.h \
+    batchkernels.h \
+    polynomial.h \
+    jitterm.h \
+    termtable.h \
+    termarena.h \
+    interval.h \
+    stdecomposition.h \
+    benchmark.h \
+    fixeddegree.h \
+    doubledouble.h \
+    gridevaluator.h \
+    factorization.h \
+    polynomialfile.h \
+    compiledfunction.h \
+    threadpool.h \
+    workstealing.h \
+    edgesamplestore.h \
+    allocationcounter.h
+
+# Debug builds, and builds with CONFIG+=benchmark, count heap allocations
+# by replacing the global operator new.
+CONFIG(debug, debug|release)|benchmark {
+    DEFINES += COUNT_ALLOCATIONS
+    SOURCES += allocationcounter.cpp
+}
 
 FORMS    += mainwindow.ui
 
@@ -0,0 +1,23 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef ALLOCATIONCOUNTER_H
+#define ALLOCATIONCOUNTER_H
+
+// The number of calls to the global operator new so far, from any thread,
+// which is every allocation of new and of the standard containers. The
+// difference across a piece of code shows whether it allocates. Counting
+// replaces the global operator new, so it is only built with
+// COUNT_ALLOCATIONS, in debug and benchmark builds; otherwise this is 0.
+#ifdef COUNT_ALLOCATIONS
+long long allocationCount();
+#else
+inline long long allocationCount() { return 0; }
+#endif
+
+#endif // ALLOCATIONCOUNTER_H
@@ -0,0 +1,209 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "batchkernels.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+// Scalar fallback.
+
+static void fill_scalar(double* dest, double val, int n)
+{
+    for (int i = 0; i < n; i++)
+        dest[i] = val;
+}
+
+static void add_scalar(double* dest, const double* a, const double* b, int n)
+{
+    for (int i = 0; i < n; i++)
+        dest[i] = a[i] + b[i];
+}
+
+static void sub_scalar(double* dest, const double* a, const double* b, int n)
+{
+    for (int i = 0; i < n; i++)
+        dest[i] = a[i] - b[i];
+}
+
+static void mul_scalar(double* dest, const double* a, const double* b, int n)
+{
+    for (int i = 0; i < n; i++)
+        dest[i] = a[i] * b[i];
+}
+
+// Repeated squaring, done for every lane at once since exp is shared.
+static void powi_scalar(double* dest, const double* base, int exp, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        double result = 1;
+        double b = base[i];
+        for (int e = exp; e; e >>= 1)
+        {
+            if (e & 1)
+                result *= b;
+            b *= b;
+        }
+        dest[i] = result;
+    }
+}
+
+static void mul_add_scalar(double* dest, const double* a, const double* b, const double* c, const double* d, int n)
+{
+    for (int i = 0; i < n; i++)
+        dest[i] = a[i]*b[i] + c[i]*d[i];
+}
+
+#ifdef HAVE_X86_KERNELS
+
+// SSE2: two lanes per instruction.
+
+__attribute__((target("sse2")))
+static void fill_sse2(double* dest, double val, int n)
+{
+    __m128d v = _mm_set1_pd(val);
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+        _mm_storeu_pd(dest + i, v);
+    fill_scalar(dest + i, val, n - i);
+}
+
+#define SSE2_BINARY_KERNEL(name, intrinsic) \
+    __attribute__((target("sse2"))) \
+    static void name##_sse2(double* dest, const double* a, const double* b, int n) \
+    { \
+        int i = 0; \
+        for (; i + 2 <= n; i += 2) \
+            _mm_storeu_pd(dest + i, intrinsic(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i))); \
+        name##_scalar(dest + i, a + i, b + i, n - i); \
+    }
+
+SSE2_BINARY_KERNEL(add, _mm_add_pd)
+SSE2_BINARY_KERNEL(sub, _mm_sub_pd)
+SSE2_BINARY_KERNEL(mul, _mm_mul_pd)
+
+__attribute__((target("sse2")))
+static void powi_sse2(double* dest, const double* base, int exp, int n)
+{
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d result = _mm_set1_pd(1.0);
+        __m128d b = _mm_loadu_pd(base + i);
+        for (int e = exp; e; e >>= 1)
+        {
+            if (e & 1)
+                result = _mm_mul_pd(result, b);
+            b = _mm_mul_pd(b, b);
+        }
+        _mm_storeu_pd(dest + i, result);
+    }
+    powi_scalar(dest + i, base + i, exp, n - i);
+}
+
+__attribute__((target("sse2")))
+static void mul_add_sse2(double* dest, const double* a, const double* b, const double* c, const double* d, int n)
+{
+    int i = 0;
+    for (; i + 2 <= n; i += 2)
+    {
+        __m128d ab = _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+        __m128d cd = _mm_mul_pd(_mm_loadu_pd(c + i), _mm_loadu_pd(d + i));
+        _mm_storeu_pd(dest + i, _mm_add_pd(ab, cd));
+    }
+    mul_add_scalar(dest + i, a + i, b + i, c + i, d + i, n - i);
+}
+
+// AVX2: four lanes per instruction.
+
+__attribute__((target("avx2")))
+static void fill_avx2(double* dest, double val, int n)
+{
+    __m256d v = _mm256_set1_pd(val);
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm256_storeu_pd(dest + i, v);
+    fill_scalar(dest + i, val, n - i);
+}
+
+#define AVX2_BINARY_KERNEL(name, intrinsic) \
+    __attribute__((target("avx2"))) \
+    static void name##_avx2(double* dest, const double* a, const double* b, int n) \
+    { \
+        int i = 0; \
+        for (; i + 4 <= n; i += 4) \
+            _mm256_storeu_pd(dest + i, intrinsic(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i))); \
+        name##_scalar(dest + i, a + i, b + i, n - i); \
+    }
+
+AVX2_BINARY_KERNEL(add, _mm256_add_pd)
+AVX2_BINARY_KERNEL(sub, _mm256_sub_pd)
+AVX2_BINARY_KERNEL(mul, _mm256_mul_pd)
+
+__attribute__((target("avx2")))
+static void powi_avx2(double* dest, const double* base, int exp, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d result = _mm256_set1_pd(1.0);
+        __m256d b = _mm256_loadu_pd(base + i);
+        for (int e = exp; e; e >>= 1)
+        {
+            if (e & 1)
+                result = _mm256_mul_pd(result, b);
+            b = _mm256_mul_pd(b, b);
+        }
+        _mm256_storeu_pd(dest + i, result);
+    }
+    powi_scalar(dest + i, base + i, exp, n - i);
+}
+
+// Not fused, so results match the other kernels bit for bit.
+__attribute__((target("avx2")))
+static void mul_add_avx2(double* dest, const double* a, const double* b, const double* c, const double* d, int n)
+{
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m256d ab = _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        __m256d cd = _mm256_mul_pd(_mm256_loadu_pd(c + i), _mm256_loadu_pd(d + i));
+        _mm256_storeu_pd(dest + i, _mm256_add_pd(ab, cd));
+    }
+    mul_add_scalar(dest + i, a + i, b + i, c + i, d + i, n - i);
+}
+
+#endif // HAVE_X86_KERNELS
+
+static BatchKernels select_kernels()
+{
+#ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        BatchKernels k = { "AVX2", fill_avx2, add_avx2, sub_avx2, mul_avx2, powi_avx2, mul_add_avx2 };
+        return k;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        BatchKernels k = { "SSE2", fill_sse2, add_sse2, sub_sse2, mul_sse2, powi_sse2, mul_add_sse2 };
+        return k;
+    }
+#endif
+    BatchKernels k = { "scalar", fill_scalar, add_scalar, sub_scalar, mul_scalar, powi_scalar, mul_add_scalar };
+    return k;
+}
+
+const BatchKernels& batchKernels()
+{
+    static const BatchKernels kernels = select_kernels();
+    return kernels;
+}
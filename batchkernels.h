@@ -0,0 +1,30 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef BATCHKERNELS_H
+#define BATCHKERNELS_H
+
+// Elementwise operations on arrays of doubles, used to run a CompiledTerm
+// over many sample points at once. dest may alias either operand.
+struct BatchKernels
+{
+    const char* name;
+    void (*fill)(double* dest, double val, int n);
+    void (*add)(double* dest, const double* a, const double* b, int n);
+    void (*sub)(double* dest, const double* a, const double* b, int n);
+    void (*mul)(double* dest, const double* a, const double* b, int n);
+    void (*powi)(double* dest, const double* base, int exp, int n);
+    // dest = a*b + c*d, as in the product rule.
+    void (*mul_add)(double* dest, const double* a, const double* b, const double* c, const double* d, int n);
+};
+
+// Picks the widest kernels the running CPU supports (AVX2, then SSE2),
+// falling back to plain loops. The choice is made once.
+const BatchKernels& batchKernels();
+
+#endif // BATCHKERNELS_H
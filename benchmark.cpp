@@ -0,0 +1,248 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "benchmark.h"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+#include <QElapsedTimer>
+
+#include "term.h"
+#include "polynomial.h"
+#include "compiledterm.h"
+#include "jitterm.h"
+#include "fixeddegree.h"
+#include "gridevaluator.h"
+#include "stdecomposition.h"
+
+// A sum of random monomials and small parenthesized factors, about length
+// characters long, in the style of computer algebra output.
+static std::string generate_polynomial(unsigned int length)
+{
+    const char* vars = "xyzst";
+    std::string result;
+    srand(1);
+
+    while (result.size() < length)
+    {
+        if (!result.empty())
+            result += rand() % 2 ? " + " : " - ";
+
+        result += std::to_string(1 + rand() % 100000);
+        int num_factors = 1 + rand() % 4;
+        for (int i = 0; i < num_factors; i++)
+        {
+            if (rand() % 5 == 0)
+                result += std::string("(") + vars[rand() % 3] + " - " + std::to_string(rand() % 10) + vars[rand() % 3] + ")";
+            else
+                result += vars[rand() % 5];
+            result += "^" + std::to_string(1 + rand() % 5);
+        }
+    }
+
+    return result;
+}
+
+void runParserBenchmark()
+{
+    for (unsigned int length = 10000; length <= 1000000; length *= 10)
+    {
+        std::string input = generate_polynomial(length);
+        TermArena arena;
+
+        const int repetitions = 10000000 / length;
+        QElapsedTimer timer;
+        timer.start();
+        for (int i = 0; i < repetitions; i++)
+        {
+            arena.reset();
+            Term::parseTerm(input, &arena);
+        }
+        double nsecs = (double)timer.nsecsElapsed() / repetitions;
+
+        std::cout << "Parsed " << input.size() << " characters into " << arena.numNodes() << " nodes in "
+                  << nsecs / 1e6 << " ms (" << nsecs / input.size() << " ns/char)." << std::endl;
+    }
+}
+
+// A ternary form of the given degree with every coefficient nonzero.
+static Polynomial generate_dense_form(int degree)
+{
+    std::vector<Polynomial::Monomial> monomials;
+    srand(degree);
+
+    for (int i = 0; i <= degree; i++)
+    {
+        for (int j = 0; i + j <= degree; j++)
+        {
+            Polynomial::Monomial m = { { i, j, degree - i - j, 0, 0 }, (double)(1 + rand() % 20) };
+            monomials.push_back(m);
+        }
+    }
+
+    return Polynomial(monomials);
+}
+
+void runEvaluatorBenchmark()
+{
+    const int n = 4096;
+    const int repetitions = 1000;
+    std::vector<double> x(n), y(n), ones(n, 1.0), out(n);
+    for (int i = 0; i < n; i++)
+    {
+        x[i] = -1 + 2.0*i/n;
+        y[i] = 1 - 2.0*(i % 64)/64;
+    }
+
+    // A view tilted off every axis, so that the charted curve is dense.
+    const double chart[3][3] = { { 0.8, -0.36, 0.48 }, { 0.6, 0.48, -0.64 }, { 0, 0.8, 0.6 } };
+
+    // The grid evaluator runs on leaves the size the renderer uses.
+    const int leaf_size = 17;
+    const int leaf_repetitions = repetitions*n/(leaf_size*leaf_size);
+    std::vector<double> leaf(leaf_size*leaf_size);
+
+    for (int degree = 1; degree <= 12; degree++)
+    {
+        Polynomial charted = generate_dense_form(degree).transformed(chart).dehomogenized();
+        CompiledTerm program(charted);
+        JitTerm* jit = JitTerm::compile(&program);
+        FixedDegreeBatch fixed = fixedDegreeBatch(degree);
+        std::vector<double> coefficients;
+        fixedDegreeCoefficients(charted, degree, &coefficients);
+
+        QElapsedTimer timer;
+        std::cout << "Degree " << degree << ", ns/sample:";
+
+        timer.start();
+        for (int r = 0; r < repetitions; r++)
+            program.evalBatch(x.data(), y.data(), ones.data(), 0, 0, out.data(), n);
+        std::cout << " compiled " << (double)timer.nsecsElapsed() / (n*repetitions);
+
+        if (jit)
+        {
+            timer.start();
+            for (int r = 0; r < repetitions; r++)
+                jit->evalBatch(x.data(), y.data(), ones.data(), 0, 0, out.data(), n);
+            std::cout << ", JIT " << (double)timer.nsecsElapsed() / (n*repetitions);
+        }
+
+        if (fixed)
+        {
+            timer.start();
+            for (int r = 0; r < repetitions; r++)
+                fixed(coefficients.data(), x.data(), y.data(), out.data(), n);
+            std::cout << ", fixed " << (double)timer.nsecsElapsed() / (n*repetitions);
+        }
+
+        timer.start();
+        for (int r = 0; r < leaf_repetitions; r++)
+            evalUniformGrid(coefficients.data(), degree, -1, 2.0/(leaf_size - 1), leaf_size,
+                            -1, 2.0/(leaf_size - 1), leaf_size, leaf.data());
+        std::cout << ", grid " << (double)timer.nsecsElapsed() / (leaf_size*leaf_size*leaf_repetitions);
+
+        std::cout << std::endl;
+        delete jit;
+    }
+}
+
+void runGradientBenchmark()
+{
+    const int n = 4096;
+    const int repetitions = 200;
+    std::vector<double> x(n), y(n), z(n);
+    for (int i = 0; i < n; i++)
+    {
+        x[i] = -1 + 2.0*i/n;
+        y[i] = 1 - 2.0*(i % 64)/64;
+        z[i] = 0.5 + 0.25*(i % 7);
+    }
+    std::vector<double> out(n), df_dx(n), df_dy(n), df_dz(n);
+
+    for (int degree = 3; degree <= 12; degree += 3)
+    {
+        TermArena arena;
+        Term* f = generate_dense_form(degree).toTerm(&arena);
+        Term* derivatives[3] = { f->derivative('x', &arena), f->derivative('y', &arena), f->derivative('z', &arena) };
+        CompiledTerm program(f);
+        CompiledTerm derivative_programs[3] = { CompiledTerm(derivatives[0]), CompiledTerm(derivatives[1]),
+                                                CompiledTerm(derivatives[2]) };
+        double* partials[3] = { df_dx.data(), df_dy.data(), df_dz.data() };
+
+        QElapsedTimer timer;
+        std::cout << "Degree " << degree << ", ns/point for f and its gradient:";
+
+        // The trees are far slower, so they get fewer points.
+        const int tree_points = n/16;
+        timer.start();
+        for (int r = 0; r < repetitions; r++)
+        {
+            for (int i = 0; i < tree_points; i++)
+            {
+                out[i] = f->eval(x[i], y[i], z[i], 0, 0);
+                for (int v = 0; v < 3; v++)
+                    partials[v][i] = derivatives[v]->eval(x[i], y[i], z[i], 0, 0);
+            }
+        }
+        double tree = (double)timer.nsecsElapsed() / (tree_points*repetitions);
+        std::cout << " trees " << tree;
+
+        timer.start();
+        for (int r = 0; r < repetitions; r++)
+        {
+            program.evalBatch(x.data(), y.data(), z.data(), 0, 0, out.data(), n);
+            for (int v = 0; v < 3; v++)
+                derivative_programs[v].evalBatch(x.data(), y.data(), z.data(), 0, 0, partials[v], n);
+        }
+        double compiled = (double)timer.nsecsElapsed() / (n*repetitions);
+        std::cout << ", four compiled " << compiled;
+
+        timer.start();
+        for (int r = 0; r < repetitions; r++)
+            program.evalGradBatch(x.data(), y.data(), z.data(), 0, 0,
+                                  out.data(), df_dx.data(), df_dy.data(), df_dz.data(), n);
+        double dual = (double)timer.nsecsElapsed() / (n*repetitions);
+        std::cout << ", dual numbers " << dual << " (" << tree/dual << "x, " << compiled/dual << "x)" << std::endl;
+    }
+}
+
+void runChartingBenchmark()
+{
+    const double chart[3][3] = { { 0.8, -0.36, 0.48 }, { 0.6, 0.48, -0.64 }, { 0, 0.8, 0.6 } };
+
+    for (int degree = 6; degree <= 192; degree *= 2)
+    {
+        Polynomial f = generate_dense_form(degree);
+        STDecomposition decomposition(f);
+
+        // Repeated until a quarter second has passed, so small degrees
+        // are not lost in the timer's resolution.
+        QElapsedTimer timer;
+        int repetitions = 0;
+        timer.start();
+        do
+        {
+            f.onChart(chart);
+            repetitions++;
+        } while (timer.elapsed() < 250);
+        double on_chart = (double)timer.nsecsElapsed() / (1e6*repetitions);
+
+        repetitions = 0;
+        timer.start();
+        do
+        {
+            decomposition.setChart(chart);
+            repetitions++;
+        } while (timer.elapsed() < 250);
+        double set_chart = (double)timer.nsecsElapsed() / (1e6*repetitions);
+
+        std::cout << "Degree " << degree << ", ms: onChart " << on_chart << ", setChart " << set_chart << std::endl;
+    }
+}
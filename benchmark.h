@@ -0,0 +1,33 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+// Times Term::parseTerm on machine-generated polynomials of 10k to 1M
+// characters and prints the results. Run with --benchmark-parser.
+void runParserBenchmark();
+
+// Times the FixedDegree evaluators against the JIT and CompiledTerm on
+// dense curves of each specialized degree and a little above, as seen on a
+// rotated chart, along with the row-wise evaluator on leaf-sized grids.
+// Run with --benchmark-evaluators.
+void runEvaluatorBenchmark();
+
+// Times CompiledTerm::evalGradBatch against evaluating f and its three
+// derivative Terms point by point, and against running CompiledTerms of
+// those derivatives in batches, on dense forms of several degrees.
+// Run with --benchmark-gradient.
+void runGradientBenchmark();
+
+// Times Polynomial::onChart, and STDecomposition::setChart around it, on
+// dense forms from degree 6 to 192, which is what every pan and zoom of a
+// loaded curve costs. Run with --benchmark-charting.
+void runChartingBenchmark();
+
+#endif // BENCHMARK_H
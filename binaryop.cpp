@@ -9,15 +9,30 @@
 #include "binaryop.h"
 
 #include <cmath>
+#include <climits>
 #include <iostream>
+#include <utility>
 #include "numericalterm.h"
 #include "variable.h"
+#include "polynomial.h"
+#include "factorization.h"
+#include "termtable.h"
+
+// The product of two exponents, as for a power of a power. Throws
+// BadTermException rather than overflow.
+static int multiply_exponents(int a, int b)
+{
+    if (b != 0 && a > INT_MAX/b)
+        throw BadTermException("Exponent too large.");
+    return a*b;
+}
 
 BinaryOp::BinaryOp(op_type op, Term* lhs, Term* rhs)
 {
     this->op = op;
     this->lhs = lhs;
     this->rhs = rhs;
+    numerical = lhs->isNumerical() && rhs->isNumerical();
 
     this->my_priority = op_priority(op);
 }
@@ -38,7 +53,7 @@ double powi(double base, int exp)
     return result;
 }
 
-double BinaryOp::eval(double x, double y, double z, double s, double t)
+double BinaryOp::eval(double x, double y, double z, double s, double t) const
 {
     double lhsval = lhs->eval(x,y,z,s,t);
     double rhsval = rhs->eval(x,y,z,s,t);
@@ -62,49 +77,66 @@ double BinaryOp::eval(double x, double y, double z, double s, double t)
     }
 }
 
-Term* BinaryOp::derivative(char var)
+Interval BinaryOp::evalInterval(const Interval& x, const Interval& y, const Interval& z, double s, double t) const
 {
+    if (op == OP_EXP)
+        return lhs->evalInterval(x,y,z,s,t).pow(exponent());
+
+    Interval lhsval = lhs->evalInterval(x,y,z,s,t);
+    Interval rhsval = rhs->evalInterval(x,y,z,s,t);
+
     switch (op)
     {
     case OP_PLUS:
-        return new BinaryOp(OP_PLUS, lhs->derivative(var), rhs->derivative(var));
+        return lhsval + rhsval;
     case OP_MINUS:
-        return new BinaryOp(OP_MINUS, lhs->derivative(var), rhs->derivative(var));
+        return lhsval - rhsval;
     case OP_TIMES:
-        // Product rule!
-    {
-        Term* rhs_clone = rhs->Clone();
-        Term* lhs_clone = lhs->Clone();
+        return lhsval * rhsval;
+    default:
+        throw BadTermException();
+    }
+}
 
-        Term* left_prod = new BinaryOp(OP_TIMES, lhs->derivative(var), rhs_clone);
-        Term* right_prod = new BinaryOp(OP_TIMES, lhs_clone, rhs->derivative(var));
+Term* BinaryOp::derivative(char var, TermArena* arena)
+{
+    switch (op)
+    {
+    case OP_PLUS:
+        return new (arena) BinaryOp(OP_PLUS, lhs->derivative(var, arena), rhs->derivative(var, arena));
+    case OP_MINUS:
+        return new (arena) BinaryOp(OP_MINUS, lhs->derivative(var, arena), rhs->derivative(var, arena));
+    case OP_TIMES:
+        // Product rule! The factors are shared, not cloned: terms never
+        // change once made, and cloning them at every level makes the
+        // derivative of a nested product grow exponentially.
+    {
+        Term* left_prod = new (arena) BinaryOp(OP_TIMES, lhs->derivative(var, arena), rhs);
+        Term* right_prod = new (arena) BinaryOp(OP_TIMES, lhs, rhs->derivative(var, arena));
 
-        return new BinaryOp(OP_PLUS, left_prod, right_prod);
+        return new (arena) BinaryOp(OP_PLUS, left_prod, right_prod);
     }
     case OP_EXP:
     {
         // Power rule!
         // Assume exponent is integral... otherwise this will not be the derivative.
-        Term* rhs_clone1 = rhs->Clone();
-        Term* rhs_clone2 = rhs->Clone();
-        Term* lhs_clone = lhs->Clone();
-
-        Term* exponent = new BinaryOp(OP_MINUS, rhs_clone1, new NumericalTerm(1));
-        Term* raise_to_exp = new BinaryOp(OP_EXP, lhs_clone, exponent);
-        Term* derivative_of_inside = lhs_clone->derivative(var);
-        Term* partial_product = new BinaryOp(OP_TIMES, rhs_clone2, derivative_of_inside);
-        return new BinaryOp(OP_TIMES, partial_product, raise_to_exp);
+        // eval reads exponents as NumericalTerms, so the lowered one is one too.
+        Term* exponent = new (arena) NumericalTerm(rhs->eval(0,0,0,1,0) - 1);
+        Term* raise_to_exp = new (arena) BinaryOp(OP_EXP, lhs, exponent);
+        Term* derivative_of_inside = lhs->derivative(var, arena);
+        Term* partial_product = new (arena) BinaryOp(OP_TIMES, rhs, derivative_of_inside);
+        return new (arena) BinaryOp(OP_TIMES, partial_product, raise_to_exp);
     }
     default:
         throw BadTermException();
     }
 }
 
-Term* BinaryOp::Clone()
+Term* BinaryOp::Clone(TermArena* arena)
 {
-    Term* lhs_clone = lhs->Clone();
-    Term* rhs_clone = rhs->Clone();
-    return new BinaryOp(op, lhs_clone, rhs_clone);
+    Term* lhs_clone = lhs->Clone(arena);
+    Term* rhs_clone = rhs->Clone(arena);
+    return new (arena) BinaryOp(op, lhs_clone, rhs_clone);
 }
 
 void BinaryOp::print()
@@ -147,155 +179,137 @@ int BinaryOp::op_priority(op_type op)
     }
 }
 
-Term* BinaryOp::simplify()
+Term* BinaryOp::simplify(TermArena* arena)
 {
-    Term* lhs_simp = lhs->simplify();
-    Term* rhs_simp = rhs->simplify();
+    Term* lhs_simp = lhs->simplify(arena);
+    Term* rhs_simp = rhs->simplify(arena);
 
     if (lhs_simp->isNumerical() && rhs_simp->isNumerical())
-    {
-        Term* result = new NumericalTerm((int)round(eval(0,0,0,1,0)));
-        delete lhs_simp;
-        delete rhs_simp;
-        return result;
-    }
+        return new (arena) NumericalTerm(round(eval(0,0,0,1,0)));
 
     switch (op)
     {
     case OP_PLUS:
         if (lhs_simp->isZero())
-        {
-            delete lhs_simp;
             return rhs_simp;
-        }
 
         if (rhs_simp->isZero())
-        {
-            delete rhs_simp;
             return lhs_simp;
-        }
         break;
     case OP_MINUS:
         if (rhs_simp->isZero())
-        {
-            delete rhs_simp;
             return lhs_simp;
-        }
         break;
     case OP_TIMES:
         if (lhs_simp->isZero())
-        {
-            delete lhs_simp;
-            delete rhs_simp;
-            return new NumericalTerm(0);
-        }
+            return new (arena) NumericalTerm(0);
 
         if (lhs_simp->isOne())
-        {
-            delete lhs_simp;
             return rhs_simp;
-        }
 
         if (rhs_simp->isZero())
-        {
-            delete lhs_simp;
-            delete rhs_simp;
-            return new NumericalTerm(0);
-        }
+            return new (arena) NumericalTerm(0);
 
         if (rhs_simp->isOne())
-        {
-            delete rhs_simp;
             return lhs_simp;
-        }
         break;
     case OP_EXP:
         if (rhs_simp->isOne())
-        {
-            delete rhs_simp;
             return lhs_simp;
-        }
 
         if (rhs_simp->isZero())
-        {
-            delete rhs_simp;
-            delete lhs_simp;
-            return new NumericalTerm(1);
-        }
+            return new (arena) NumericalTerm(1);
 
         if (lhs_simp->isOne())
-        {
-            delete rhs_simp;
-            delete lhs_simp;
-            return new NumericalTerm(1);
-        }
+            return new (arena) NumericalTerm(1);
 
         if (lhs_simp->isZero())
-        {
-            delete rhs_simp;
-            delete lhs_simp;
-            return new NumericalTerm(0);
-        }
+            return new (arena) NumericalTerm(0);
     }
 
-    return new BinaryOp(op, lhs_simp, rhs_simp);
+    return new (arena) BinaryOp(op, lhs_simp, rhs_simp);
 }
 
-Term* BinaryOp::homogenize(int* degree)
+Polynomial BinaryOp::toPolynomial()
 {
-    int lhs_degree;
-    int rhs_degree;
-    Term* lhs_hommed = lhs->homogenize(&lhs_degree);
-    Term* rhs_hommed = rhs->homogenize(&rhs_degree);
-
     switch (op)
     {
     case OP_PLUS:
     case OP_MINUS:
-        if (lhs_degree > rhs_degree)
+    {
+        // A sum of n terms is a tree n deep, so it is walked with a stack
+        // of its own. Every summand's monomials go into one list, which is
+        // sorted once, as the file parser does, rather than the sum so far
+        // being copied and sorted at every + and -.
+        std::vector<Polynomial::Monomial> monomials;
+        std::vector<std::pair<Term*, double> > pending(1, std::make_pair((Term*)this, 1.0));
+        while (!pending.empty())
         {
-            *degree = lhs_degree;
+            Term* term = pending.back().first;
+            double sign = pending.back().second;
+            pending.pop_back();
 
-            if (lhs_degree - rhs_degree == 1)
+            if (term->isSum())
             {
-                Term* rhs_more_hommed = new BinaryOp(OP_TIMES, rhs_hommed, new Variable(Variable::VAR_Z));
-                return new BinaryOp(op, lhs_hommed, rhs_more_hommed);
+                BinaryOp* sum = (BinaryOp*)term;
+                pending.push_back(std::make_pair(sum->rhs, sum->op == OP_MINUS ? -sign : sign));
+                pending.push_back(std::make_pair(sum->lhs, sign));
+                continue;
             }
-            else
-            {
-                Term* rhs_adjustment = new BinaryOp(OP_EXP, new Variable(Variable::VAR_Z), new NumericalTerm(lhs_degree - rhs_degree));
-                Term* rhs_more_hommed = new BinaryOp(OP_TIMES, rhs_hommed, rhs_adjustment);
-                return new BinaryOp(op, lhs_hommed, rhs_more_hommed);
-            }
-        }
-        else if (lhs_degree < rhs_degree)
-        {
-            *degree = rhs_degree;
 
-            if (rhs_degree - lhs_degree == 1)
-            {
-                Term* lhs_more_hommed = new BinaryOp(OP_TIMES, lhs_hommed, new Variable(Variable::VAR_Z));
-                return new BinaryOp(op, lhs_more_hommed, rhs_hommed);
-            }
-            else
+            Polynomial summand = term->toPolynomial();
+            for (unsigned int i = 0; i < summand.getMonomials().size(); i++)
             {
-                Term* lhs_adjustment = new BinaryOp(OP_EXP, new Variable(Variable::VAR_Z), new NumericalTerm(rhs_degree - lhs_degree));
-                Term* lhs_more_hommed = new BinaryOp(OP_TIMES, lhs_hommed, lhs_adjustment);
-                return new BinaryOp(op, lhs_more_hommed, rhs_hommed);
+                monomials.push_back(summand.getMonomials()[i]);
+                monomials.back().coefficient *= sign;
             }
         }
-        else
+        return Polynomial(monomials);
+    }
+    case OP_TIMES:
+        return lhs->toPolynomial() * rhs->toPolynomial();
+    case OP_EXP: // Relies on numerical exponents.
+    {
+        Polynomial base = lhs->toPolynomial();
+        int n = exponent();
+        const std::vector<Polynomial::Monomial>& monomials = base.getMonomials();
+        for (unsigned int i = 0; i < monomials.size(); i++)
         {
-            *degree = lhs_degree;
-            return new BinaryOp(op, lhs_hommed, rhs_hommed);
+            for (int v = 0; v < Polynomial::NUM_VARS; v++)
+                multiply_exponents(monomials[i].exponents[v], n);
         }
+        return base.pow(n);
+    }
+    default:
+        throw BadTermException();
+    }
+}
+
+int BinaryOp::exponent() const
+{
+    double value = rhs->eval(0,0,0,1,0);
+    if (!(value >= 0 && value <= INT_MAX) || value != std::floor(value))
+        throw BadTermException("Exponent must be a whole number below 2^31.");
+    return (int)value;
+}
+
+void BinaryOp::addFactors(int multiplicity, std::vector<Factor>* factors)
+{
+    switch (op)
+    {
     case OP_TIMES:
-        *degree = lhs_degree + rhs_degree;
-        return new BinaryOp(OP_TIMES, lhs_hommed, rhs_hommed);
+        lhs->addFactors(multiplicity, factors);
+        rhs->addFactors(multiplicity, factors);
+        break;
     case OP_EXP: // Relies on numerical exponents.
-        int exponent_val = (int)round(rhs_hommed->eval(0,0,0,1,0));
-        *degree = lhs_degree * exponent_val;
-        return new BinaryOp(OP_EXP, lhs_hommed,rhs_hommed);
+        lhs->addFactors(multiply_exponents(multiplicity, exponent()), factors);
+        break;
+    default:
+        Term::addFactors(multiplicity, factors);
     }
-    throw BadTermException();
+}
+
+Term* BinaryOp::intern(TermTable* table)
+{
+    return table->binaryOp(op, lhs->intern(table), rhs->intern(table));
 }
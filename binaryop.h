@@ -16,28 +16,36 @@ class BinaryOp : public Term
 public:
     enum op_type { OP_PLUS, OP_TIMES, OP_MINUS, OP_EXP };
 
+    // lhs and rhs are not owned; they live in an arena like this node.
     BinaryOp(op_type op, Term* lhs, Term* rhs);
 
-    virtual ~BinaryOp()
-    {
-        if (lhs) delete lhs;
-        if (rhs) delete rhs;
-        lhs = 0;
-        rhs = 0;
-    };
-
-    virtual double eval(double x, double y, double z, double s, double t);
-    virtual Term* derivative(char var);
-    virtual Term* Clone();
+    virtual double eval(double x, double y, double z, double s, double t) const;
+    virtual Interval evalInterval(const Interval& x, const Interval& y, const Interval& z, double s, double t) const;
+    virtual Term* derivative(char var, TermArena* arena);
+    virtual Term* Clone(TermArena* arena);
     virtual void print();
     static int op_priority(op_type op);
-    virtual Term* simplify();
-    virtual bool isNumerical() { return lhs->isNumerical() && rhs->isNumerical(); }
-    virtual Term* homogenize(int* degree);
+    virtual Term* simplify(TermArena* arena);
+    virtual bool isNumerical() { return numerical; }
+    virtual bool isSum() { return op == OP_PLUS || op == OP_MINUS; }
+    virtual bool isProduct() { return op == OP_TIMES || op == OP_EXP; }
+    virtual Polynomial toPolynomial();
+    virtual void addFactors(int multiplicity, std::vector<Factor>* factors);
+    virtual Term* intern(TermTable* table);
+    virtual int numNodes() { return 1 + lhs->numNodes() + rhs->numNodes(); }
+    // For OP_EXP, rhs as an int. Throws BadTermException unless it is a
+    // whole number from 0 to INT_MAX.
+    int exponent() const;
 private:
     op_type op;
     Term* lhs;
     Term* rhs;
+    // Found once when the node is made, as simplify asks at every node of
+    // sums as deep as they are long.
+    bool numerical;
 };
 
+// Computes base^exp by repeated squaring. exp must be non-negative.
+double powi(double base, int exp);
+
 #endif // BINARYOP_H
@@ -0,0 +1,14 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "compiledfunction.h"
+
+CompiledFunction::CompiledFunction(const std::vector<Factor>& factors)
+    : factors(factors)
+{
+}
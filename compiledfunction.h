@@ -0,0 +1,39 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef COMPILEDFUNCTION_H
+#define COMPILEDFUNCTION_H
+
+#include <memory>
+#include <vector>
+
+#include "factorization.h"
+
+// A function as it is handed from the editor to the renderer: its
+// square-free factors, each of which the renderer draws as a curve. It
+// never changes once made, and is passed around as a SharedFunction, so
+// everyone holding it shares one copy and reading it needs no locking.
+class CompiledFunction
+{
+public:
+    // factors are the square-free factors of the function, as from
+    // factorize.
+    explicit CompiledFunction(const std::vector<Factor>& factors);
+
+    const std::vector<Factor>& getFactors() const { return factors; }
+
+private:
+    CompiledFunction(const CompiledFunction&);
+    CompiledFunction& operator=(const CompiledFunction&);
+
+    const std::vector<Factor> factors;
+};
+
+typedef std::shared_ptr<const CompiledFunction> SharedFunction;
+
+#endif // COMPILEDFUNCTION_H
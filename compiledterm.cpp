@@ -0,0 +1,324 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "compiledterm.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "binaryop.h"
+#include "batchkernels.h"
+
+// The register files evaluation runs in. Each thread has its own, so any
+// number of threads can evaluate the same CompiledTerm at once. They grow
+// to fit the largest program run on the thread, and are kept for the next.
+struct EvalScratch
+{
+    std::vector<double> registers;
+    std::vector<double> batch_registers;
+    std::vector<double> dual_registers;
+    std::vector<char> dual_varying;
+    std::vector<double> dual_scratch;
+};
+
+static thread_local EvalScratch eval_scratch;
+
+static double* grown(std::vector<double>* v, int size)
+{
+    if ((int)v->size() < size)
+        v->resize(size);
+    return v->data();
+}
+
+CompiledTerm::CompiledTerm(Term* f)
+{
+    TermTable table;
+    result_register = table.compile(table.intern(f), this);
+}
+
+CompiledTerm::CompiledTerm(const Polynomial& p)
+{
+    result_register = p.compile(this);
+}
+
+int CompiledTerm::allocRegister()
+{
+    if (free_registers.empty())
+        return num_registers++;
+
+    int reg = free_registers.back();
+    free_registers.pop_back();
+    return reg;
+}
+
+void CompiledTerm::freeRegister(int reg)
+{
+    if (reg < (int)register_uses.size() && register_uses[reg] > 1)
+    {
+        register_uses[reg]--;
+        return;
+    }
+    free_registers.push_back(reg);
+}
+
+void CompiledTerm::pinRegister(int reg)
+{
+    retainRegister(reg, INT_MAX/2);
+}
+
+void CompiledTerm::retainRegister(int reg, int extra_uses)
+{
+    if (reg >= (int)register_uses.size())
+        register_uses.resize(reg + 1, 1);
+    register_uses[reg] = 1 + extra_uses;
+}
+
+int CompiledTerm::emitLoadVar(int var)
+{
+    Instruction instr = { OP_LOAD_VAR, allocRegister(), var, 0 };
+    code.push_back(instr);
+    return instr.dest;
+}
+
+int CompiledTerm::emitLoadConst(double val)
+{
+    constants.push_back(val);
+    Instruction instr = { OP_LOAD_CONST, allocRegister(), (int)constants.size() - 1, 0 };
+    code.push_back(instr);
+    return instr.dest;
+}
+
+int CompiledTerm::emitBinary(opcode op, int lhs, int rhs)
+{
+    // Free the operands first so the result can overwrite one of them;
+    // this keeps the register file about as deep as the tree.
+    freeRegister(rhs);
+    freeRegister(lhs);
+    Instruction instr = { op, allocRegister(), lhs, rhs };
+    code.push_back(instr);
+    return instr.dest;
+}
+
+int CompiledTerm::emitPowi(int base, int exponent)
+{
+    freeRegister(base);
+    Instruction instr = { OP_POWI, allocRegister(), base, exponent };
+    code.push_back(instr);
+    return instr.dest;
+}
+
+double CompiledTerm::eval(double x, double y, double z, double s, double t) const
+{
+    const double vars[5] = { x, y, z, s, t };
+    double* r = grown(&eval_scratch.registers, num_registers);
+    const Instruction* instr = code.data();
+    const Instruction* end = instr + code.size();
+
+    for (; instr != end; instr++)
+    {
+        switch (instr->op)
+        {
+        case OP_LOAD_VAR:
+            r[instr->dest] = vars[instr->a];
+            break;
+        case OP_LOAD_CONST:
+            r[instr->dest] = constants[instr->a];
+            break;
+        case OP_ADD:
+            r[instr->dest] = r[instr->a] + r[instr->b];
+            break;
+        case OP_SUB:
+            r[instr->dest] = r[instr->a] - r[instr->b];
+            break;
+        case OP_MUL:
+            r[instr->dest] = r[instr->a] * r[instr->b];
+            break;
+        case OP_POWI:
+            r[instr->dest] = powi(r[instr->a], instr->b);
+            break;
+        }
+    }
+
+    return r[result_register];
+}
+
+void CompiledTerm::evalBatch(const double* x, const double* y, const double* z, double s, double t, double* out, int n) const
+{
+    const BatchKernels& k = batchKernels();
+    const double* vars[3];
+    double* r = grown(&eval_scratch.batch_registers, num_registers*BATCH_SIZE);
+    const Instruction* begin = code.data();
+    const Instruction* end = begin + code.size();
+
+    for (int offset = 0; offset < n; offset += BATCH_SIZE)
+    {
+        int m = n - offset < BATCH_SIZE ? n - offset : BATCH_SIZE;
+        vars[0] = x + offset;
+        vars[1] = y + offset;
+        vars[2] = z + offset;
+
+        for (const Instruction* instr = begin; instr != end; instr++)
+        {
+            double* dest = r + instr->dest*BATCH_SIZE;
+            switch (instr->op)
+            {
+            case OP_LOAD_VAR:
+                if (instr->a < 3)
+                    std::copy(vars[instr->a], vars[instr->a] + m, dest);
+                else
+                    k.fill(dest, instr->a == 3 ? s : t, m);
+                break;
+            case OP_LOAD_CONST:
+                k.fill(dest, constants[instr->a], m);
+                break;
+            case OP_ADD:
+                k.add(dest, r + instr->a*BATCH_SIZE, r + instr->b*BATCH_SIZE, m);
+                break;
+            case OP_SUB:
+                k.sub(dest, r + instr->a*BATCH_SIZE, r + instr->b*BATCH_SIZE, m);
+                break;
+            case OP_MUL:
+                k.mul(dest, r + instr->a*BATCH_SIZE, r + instr->b*BATCH_SIZE, m);
+                break;
+            case OP_POWI:
+                k.powi(dest, r + instr->a*BATCH_SIZE, instr->b, m);
+                break;
+            }
+        }
+
+        std::copy(r + result_register*BATCH_SIZE, r + result_register*BATCH_SIZE + m, out + offset);
+    }
+}
+
+void CompiledTerm::evalGradBatch(const double* x, const double* y, const double* z, double s, double t,
+                                 double* out, double* df_dx, double* df_dy, double* df_dz, int n) const
+{
+    const BatchKernels& k = batchKernels();
+    const double* vars[3];
+    double* outs[4] = { out, df_dx, df_dy, df_dz };
+    double* r = grown(&eval_scratch.dual_registers, 4*num_registers*BATCH_SIZE);
+    double* factor = grown(&eval_scratch.dual_scratch, BATCH_SIZE);
+    const Instruction* begin = code.data();
+    const Instruction* end = begin + code.size();
+    const int STRIDE = 4*BATCH_SIZE;
+
+    // Whether each register depends on x, y or z. The partials of registers
+    // that don't are zero and are neither written nor read. Many Horner
+    // operands are constants or powers of s and t, so this saves real work.
+    std::vector<char>& varying = eval_scratch.dual_varying;
+    varying.assign(num_registers, 0);
+
+    for (int offset = 0; offset < n; offset += BATCH_SIZE)
+    {
+        int m = n - offset < BATCH_SIZE ? n - offset : BATCH_SIZE;
+        vars[0] = x + offset;
+        vars[1] = y + offset;
+        vars[2] = z + offset;
+
+        for (const Instruction* instr = begin; instr != end; instr++)
+        {
+            // Component c of a register lives at reg*STRIDE + c*BATCH_SIZE;
+            // component 0 is the value. dest may be a or b.
+            double* dest = r + instr->dest*STRIDE;
+            const double* a = r + instr->a*STRIDE;
+            const double* b = r + instr->b*STRIDE;
+            switch (instr->op)
+            {
+            case OP_LOAD_VAR:
+                if (instr->a < 3)
+                {
+                    std::copy(vars[instr->a], vars[instr->a] + m, dest);
+                    for (int c = 1; c < 4; c++)
+                        k.fill(dest + c*BATCH_SIZE, c == instr->a + 1 ? 1 : 0, m);
+                }
+                else
+                    k.fill(dest, instr->a == 3 ? s : t, m);
+                varying[instr->dest] = instr->a < 3;
+                break;
+            case OP_LOAD_CONST:
+                k.fill(dest, constants[instr->a], m);
+                varying[instr->dest] = 0;
+                break;
+            case OP_ADD:
+            case OP_SUB:
+            {
+                void (*binary)(double*, const double*, const double*, int) = instr->op == OP_ADD ? k.add : k.sub;
+                bool a_varies = varying[instr->a];
+                bool b_varies = varying[instr->b];
+                for (int c = 1; c < 4; c++)
+                {
+                    double* dc = dest + c*BATCH_SIZE;
+                    const double* ac = a + c*BATCH_SIZE;
+                    const double* bc = b + c*BATCH_SIZE;
+                    if (a_varies && b_varies)
+                        binary(dc, ac, bc, m);
+                    else if (a_varies)
+                        std::copy(ac, ac + m, dc);
+                    else if (b_varies && instr->op == OP_ADD)
+                        std::copy(bc, bc + m, dc);
+                    else if (b_varies)
+                        for (int i = 0; i < m; i++)
+                            dc[i] = -bc[i];
+                }
+                binary(dest, a, b, m);
+                varying[instr->dest] = a_varies || b_varies;
+                break;
+            }
+            case OP_MUL:
+            {
+                // (ab)' = a b' + b a'. The value goes last, since the partials
+                // need both operand values.
+                bool a_varies = varying[instr->a];
+                bool b_varies = varying[instr->b];
+                for (int c = 1; c < 4; c++)
+                {
+                    double* dc = dest + c*BATCH_SIZE;
+                    const double* ac = a + c*BATCH_SIZE;
+                    const double* bc = b + c*BATCH_SIZE;
+                    if (a_varies && b_varies)
+                        k.mul_add(dc, a, bc, b, ac, m);
+                    else if (a_varies)
+                        k.mul(dc, b, ac, m);
+                    else if (b_varies)
+                        k.mul(dc, a, bc, m);
+                }
+                k.mul(dest, a, b, m);
+                varying[instr->dest] = a_varies || b_varies;
+                break;
+            }
+            case OP_POWI:
+            {
+                // (a^n)' = n a^(n-1) a'.
+                int e = instr->b;
+                bool a_varies = varying[instr->a] && e > 0;
+                if (a_varies)
+                {
+                    k.powi(factor, a, e - 1, m);
+                    for (int i = 0; i < m; i++)
+                        factor[i] *= e;
+                    for (int c = 1; c < 4; c++)
+                        k.mul(dest + c*BATCH_SIZE, factor, a + c*BATCH_SIZE, m);
+                }
+                k.powi(dest, a, e, m);
+                varying[instr->dest] = a_varies;
+                break;
+            }
+            }
+        }
+
+        double* result = r + result_register*STRIDE;
+        std::copy(result, result + m, out + offset);
+        for (int c = 1; c < 4; c++)
+        {
+            if (varying[result_register])
+                std::copy(result + c*BATCH_SIZE, result + c*BATCH_SIZE + m, outs[c] + offset);
+            else
+                std::fill(outs[c] + offset, outs[c] + offset + m, 0.0);
+        }
+    }
+}
@@ -0,0 +1,97 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef COMPILEDTERM_H
+#define COMPILEDTERM_H
+
+#include <vector>
+
+#include "term.h"
+#include "polynomial.h"
+#include "termtable.h"
+
+// A Term lowered into a flat list of register-based instructions.
+// Evaluating this is a single loop over an array with no virtual calls,
+// so it is what the renderer uses for sampling. The Term tree it came from
+// is still the thing to use for symbolic work (derivatives, printing, etc.).
+class CompiledTerm
+{
+public:
+    enum opcode { OP_LOAD_VAR, OP_LOAD_CONST, OP_ADD, OP_SUB, OP_MUL, OP_POWI };
+
+    // For OP_LOAD_VAR, a is the variable index (x, y, z, s, t = 0..4).
+    // For OP_LOAD_CONST, a is an index into the constant table.
+    // For OP_POWI, a is the base register and b is the exponent.
+    // Otherwise a and b are the operand registers.
+    struct Instruction
+    {
+        opcode op;
+        int dest;
+        int a;
+        int b;
+    };
+
+    // Compiles f by way of a TermTable, so that structurally equal
+    // subterms are computed once rather than once per copy.
+    CompiledTerm(Term* f);
+    // Compiles p as a nested Horner scheme, which is usually far shorter
+    // than compiling the Term it came from.
+    CompiledTerm(const Polynomial& p);
+
+    // Evaluation is const and re-entrant: the registers it works in belong
+    // to the calling thread, so one CompiledTerm can be shared by several.
+    double eval(double x, double y, double z, double s, double t) const;
+
+    // Evaluates at n points whose coordinates are given as separate x, y, z
+    // arrays, writing the values to out. s and t are shared by every point.
+    // Runs each instruction across a block of points with SIMD kernels.
+    void evalBatch(const double* x, const double* y, const double* z, double s, double t, double* out, int n) const;
+
+    // Like evalBatch, but also writes the partial derivatives of f in x, y
+    // and z at each point. Runs the program once over dual numbers, which
+    // carry a value and its gradient through every instruction, so this
+    // costs far less than evaluating three derivative Terms.
+    void evalGradBatch(const double* x, const double* y, const double* z, double s, double t,
+                       double* out, double* df_dx, double* df_dy, double* df_dz, int n) const;
+
+    int numInstructions() const { return code.size(); }
+    int numRegisters() const { return num_registers; }
+    int resultRegister() const { return result_register; }
+    const std::vector<Instruction>& getCode() const { return code; }
+    const std::vector<double>& getConstants() const { return constants; }
+
+    // Used by Term::compile implementations. Each returns the register
+    // holding the result. Operand registers are released for reuse.
+    int emitLoadVar(int var);
+    int emitLoadConst(double val);
+    int emitBinary(opcode op, int lhs, int rhs);
+    int emitPowi(int base, int exponent);
+    // Keeps reg from being released when it is used as an operand,
+    // for values that are read many times.
+    void pinRegister(int reg);
+    // Lets reg be used as an operand extra_uses more times before it is released.
+    void retainRegister(int reg, int extra_uses);
+
+private:
+    int allocRegister();
+    void freeRegister(int reg);
+
+    std::vector<Instruction> code;
+    std::vector<double> constants;
+    std::vector<int> free_registers;
+    std::vector<int> register_uses; // Operand reads left before a register is free.
+    int num_registers = 0;
+    int result_register = 0;
+
+    // Number of points evalBatch pushes through each instruction at a time.
+    // In evalGradBatch each register is a value followed by its three
+    // partials, each BATCH_SIZE long.
+    static const int BATCH_SIZE = 64;
+};
+
+#endif // COMPILEDTERM_H
@@ -0,0 +1,86 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef DOUBLEDOUBLE_H
+#define DOUBLEDOUBLE_H
+
+// An unevaluated sum hi + lo of two doubles with |lo| at most half an ulp
+// of hi, giving about 106 bits of precision. Built from the error-free
+// transformations of Dekker and Knuth, so it needs no FMA and no
+// particular rounding mode beyond the default.
+struct DoubleDouble
+{
+    double hi;
+    double lo;
+
+    DoubleDouble(double value = 0) : hi(value), lo(0) {}
+    DoubleDouble(double hi, double lo) : hi(hi), lo(lo) {}
+};
+
+// a + b = sum + error exactly.
+inline DoubleDouble two_sum(double a, double b)
+{
+    double sum = a + b;
+    double b_virtual = sum - a;
+    double error = (a - (sum - b_virtual)) + (b - b_virtual);
+    return DoubleDouble(sum, error);
+}
+
+inline DoubleDouble quick_two_sum(double a, double b) // Needs |a| >= |b|.
+{
+    double sum = a + b;
+    return DoubleDouble(sum, b - (sum - a));
+}
+
+// Splits a into two halves of 26 bits each, so their products are exact.
+inline void split(double a, double* high, double* low)
+{
+    double t = 134217729.0*a; // 2^27 + 1
+    *high = t - (t - a);
+    *low = a - *high;
+}
+
+// a*b = product + error exactly, barring overflow.
+inline DoubleDouble two_prod(double a, double b)
+{
+    double a_high, a_low, b_high, b_low;
+    split(a, &a_high, &a_low);
+    split(b, &b_high, &b_low);
+    double product = a*b;
+    double error = ((a_high*b_high - product) + a_high*b_low + a_low*b_high) + a_low*b_low;
+    return DoubleDouble(product, error);
+}
+
+inline DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b)
+{
+    DoubleDouble s = two_sum(a.hi, b.hi);
+    DoubleDouble t = two_sum(a.lo, b.lo);
+    s.lo += t.hi;
+    s = quick_two_sum(s.hi, s.lo);
+    s.lo += t.lo;
+    return quick_two_sum(s.hi, s.lo);
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a)
+{
+    return DoubleDouble(-a.hi, -a.lo);
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b)
+{
+    return a + (-b);
+}
+
+inline DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b)
+{
+    DoubleDouble p = two_prod(a.hi, b.hi);
+    p.lo += a.hi*b.lo + a.lo*b.hi;
+    return quick_two_sum(p.hi, p.lo);
+}
+
+#endif // DOUBLEDOUBLE_H
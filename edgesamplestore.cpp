@@ -0,0 +1,40 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "edgesamplestore.h"
+
+#include <algorithm>
+
+bool EdgeSampleStore::find(unsigned long long key, double* out) const
+{
+    Stripe& s = stripe(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    std::unordered_map<unsigned long long, std::vector<double> >::const_iterator edge = s.edges.find(key);
+    if (edge == s.edges.end())
+        return false;
+    std::copy(edge->second.begin(), edge->second.end(), out);
+    return true;
+}
+
+void EdgeSampleStore::insert(unsigned long long key, const double* values, int n)
+{
+    Stripe& s = stripe(key);
+    std::lock_guard<std::mutex> lock(s.mutex);
+    std::vector<double>& edge = s.edges[key];
+    if (edge.empty())
+        edge.assign(values, values + n);
+}
+
+void EdgeSampleStore::clear()
+{
+    for (int i = 0; i < NUM_STRIPES; i++)
+    {
+        std::lock_guard<std::mutex> lock(stripes[i].mutex);
+        stripes[i].edges.clear();
+    }
+}
@@ -0,0 +1,54 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef EDGESAMPLESTORE_H
+#define EDGESAMPLESTORE_H
+
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Samples along the edges of quadtree nodes, keyed by where the edge lies
+// on the grid of its level, so that of two nodes sharing an edge only the
+// first evaluates it. An edge is a flat array of doubles, laid out as the
+// caller likes. Any number of threads can use a store at once: it is split
+// into stripes by key, each with its own lock, so threads rarely wait on
+// each other.
+class EdgeSampleStore
+{
+public:
+    EdgeSampleStore() {}
+
+    // Copies the edge stored under key to out, which must have room for
+    // it, and returns whether there was one.
+    bool find(unsigned long long key, double* out) const;
+    // Stores n values under key, unless another thread got there first.
+    void insert(unsigned long long key, const double* values, int n);
+    void clear();
+
+private:
+    EdgeSampleStore(const EdgeSampleStore&);
+    EdgeSampleStore& operator=(const EdgeSampleStore&);
+
+    static const int NUM_STRIPES = 64;
+
+    struct Stripe
+    {
+        mutable std::mutex mutex;
+        std::unordered_map<unsigned long long, std::vector<double> > edges;
+    };
+
+    Stripe& stripe(unsigned long long key) const
+    {
+        return stripes[(key ^ key >> 17 ^ key >> 31)%NUM_STRIPES];
+    }
+
+    mutable Stripe stripes[NUM_STRIPES];
+};
+
+#endif // EDGESAMPLESTORE_H
@@ -0,0 +1,308 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "factorization.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "term.h"
+
+// Thrown when a result would not be an integer held exactly in a double,
+// or when a division that should be exact is not.
+class InexactException
+{
+};
+
+// Coefficients are kept below 2^52, so that the sum or difference of two
+// of them is still exact.
+static const double EXACT_LIMIT = 4503599627370496.0;
+
+// Pieces with more monomials than this are kept whole. The gcds grow
+// quickly with the size of their inputs; a polynomial loaded from a file
+// can have hundreds of thousands of monomials.
+static const unsigned int MAX_GCD_MONOMIALS = 1000;
+
+static double max_abs_coefficient(const Polynomial& p)
+{
+    double result = 0;
+    const std::vector<Polynomial::Monomial>& monomials = p.getMonomials();
+    for (unsigned int i = 0; i < monomials.size(); i++)
+        result = std::max(result, std::abs(monomials[i].coefficient));
+    return result;
+}
+
+static void check_exact(const Polynomial& p)
+{
+    const std::vector<Polynomial::Monomial>& monomials = p.getMonomials();
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        double c = monomials[i].coefficient;
+        if (std::abs(c) >= EXACT_LIMIT || c != std::floor(c))
+            throw InexactException();
+    }
+}
+
+static Polynomial multiply(const Polynomial& a, const Polynomial& b)
+{
+    // Each coefficient of the product sums at most this many products.
+    double terms = std::min(a.getMonomials().size(), b.getMonomials().size());
+    if (max_abs_coefficient(a)*max_abs_coefficient(b)*terms >= EXACT_LIMIT)
+        throw InexactException();
+    return a*b;
+}
+
+static Polynomial subtract(const Polynomial& a, const Polynomial& b)
+{
+    Polynomial result = a - b;
+    check_exact(result);
+    return result;
+}
+
+static Polynomial power_of(int var, int exponent)
+{
+    return Polynomial::variable(var).pow(exponent);
+}
+
+// a/b, where b divides a. Long division by leading terms finds it in any
+// monomial order, and the monomials are kept in lexicographic order.
+static Polynomial divide_exact(const Polynomial& a, const Polynomial& b)
+{
+    const Polynomial::Monomial& lead = b.getMonomials()[0];
+    std::vector<Polynomial::Monomial> quotient;
+    Polynomial remainder = a;
+    while (!remainder.isZero())
+    {
+        Polynomial::Monomial m = remainder.getMonomials()[0];
+        for (int v = 0; v < Polynomial::NUM_VARS; v++)
+        {
+            m.exponents[v] -= lead.exponents[v];
+            if (m.exponents[v] < 0)
+                throw InexactException();
+        }
+        m.coefficient /= lead.coefficient;
+        if (m.coefficient != std::floor(m.coefficient))
+            throw InexactException();
+
+        quotient.push_back(m);
+        remainder = subtract(remainder, multiply(Polynomial(std::vector<Polynomial::Monomial>(1, m)), b));
+    }
+    return Polynomial(quotient);
+}
+
+static double integer_gcd(double a, double b)
+{
+    a = std::abs(a);
+    b = std::abs(b);
+    while (b != 0)
+    {
+        double r = std::fmod(a, b);
+        a = b;
+        b = r;
+    }
+    return a;
+}
+
+// The first variable in which p has positive degree, or -1 for a constant.
+static int main_variable(const Polynomial& p)
+{
+    for (int v = 0; v < Polynomial::NUM_VARS; v++)
+    {
+        if (p.degreeIn(v) > 0)
+            return v;
+    }
+    return -1;
+}
+
+static Polynomial with_positive_lead(const Polynomial& p)
+{
+    if (!p.isZero() && p.getMonomials()[0].coefficient < 0)
+        return p*Polynomial(-1.0);
+    return p;
+}
+
+static Polynomial gcd(const Polynomial& a, const Polynomial& b);
+
+// The gcd of the coefficients of p as a polynomial in var.
+static Polynomial content(const Polynomial& p, int var)
+{
+    Polynomial result;
+    for (int k = p.degreeIn(var); k >= 0; k--)
+    {
+        Polynomial coefficient = p.coefficientOf(var, k);
+        if (!coefficient.isZero())
+            result = gcd(result, coefficient);
+        if (result == Polynomial(1.0))
+            break;
+    }
+    return result;
+}
+
+// lead(q)^k p mod q as polynomials in var, with no division.
+static Polynomial pseudo_remainder(const Polynomial& p, const Polynomial& q, int var)
+{
+    int q_degree = q.degreeIn(var);
+    Polynomial lead = q.coefficientOf(var, q_degree);
+    Polynomial r = p;
+    while (!r.isZero() && r.degreeIn(var) >= q_degree)
+    {
+        int r_degree = r.degreeIn(var);
+        Polynomial shifted = multiply(multiply(r.coefficientOf(var, r_degree), power_of(var, r_degree - q_degree)), q);
+        r = subtract(multiply(lead, r), shifted);
+    }
+    return r;
+}
+
+// Recursive in the variables: the content of each input is a gcd in the
+// variables after the first one present, and the primitive parts go
+// through a primitive remainder sequence in that one.
+static Polynomial gcd(const Polynomial& a, const Polynomial& b)
+{
+    if (a.isZero())
+        return with_positive_lead(b);
+    if (b.isZero())
+        return with_positive_lead(a);
+
+    int var_a = main_variable(a);
+    int var_b = main_variable(b);
+    int var = var_a == -1 ? var_b : (var_b == -1 ? var_a : std::min(var_a, var_b));
+    if (var == -1)
+        return Polynomial(integer_gcd(a.getMonomials()[0].coefficient, b.getMonomials()[0].coefficient));
+
+    Polynomial content_a = content(a, var);
+    Polynomial content_b = content(b, var);
+    Polynomial p = divide_exact(a, content_a);
+    Polynomial q = divide_exact(b, content_b);
+    if (p.degreeIn(var) < q.degreeIn(var))
+        std::swap(p, q);
+
+    while (q.degreeIn(var) > 0)
+    {
+        Polynomial r = pseudo_remainder(p, q, var);
+        p = q;
+        q = r.isZero() ? r : divide_exact(r, content(r, var));
+    }
+
+    // A remainder free of var means the primitive parts are coprime.
+    Polynomial primitive = q.isZero() ? with_positive_lead(p) : Polynomial(1.0);
+    return multiply(gcd(content_a, content_b), primitive);
+}
+
+static void add_factor(const Polynomial& p, int multiplicity, std::vector<Factor>* factors)
+{
+    // Nothing to draw for a constant, or a factor in s and t alone.
+    if (p.isZero() || p.degree() == 0)
+        return;
+
+    Polynomial normalized = with_positive_lead(p);
+    for (unsigned int i = 0; i < factors->size(); i++)
+    {
+        if ((*factors)[i].polynomial == normalized)
+        {
+            (*factors)[i].multiplicity += multiplicity;
+            return;
+        }
+    }
+    Factor factor = { normalized, multiplicity };
+    factors->push_back(factor);
+}
+
+// Adds the square-free factors of p^multiplicity.
+static void square_free(Polynomial p, int multiplicity, std::vector<Factor>* factors)
+{
+    if (p.isZero())
+        return;
+
+    for (int v = 0; v < Polynomial::NUM_VARS; v++)
+    {
+        const std::vector<Polynomial::Monomial>& monomials = p.getMonomials();
+        int lowest = monomials[0].exponents[v];
+        for (unsigned int i = 1; i < monomials.size(); i++)
+            lowest = std::min(lowest, monomials[i].exponents[v]);
+        if (lowest > 0)
+        {
+            add_factor(Polynomial::variable(v), multiplicity*lowest, factors);
+            p = divide_exact(p, power_of(v, lowest));
+        }
+    }
+
+    int var = main_variable(p);
+    if (var == -1)
+        return;
+
+    // What doesn't involve var is in the content; Yun's algorithm below
+    // needs p primitive.
+    Polynomial c = content(p, var);
+    square_free(c, multiplicity, factors);
+    p = divide_exact(p, c);
+
+    // Yun's algorithm: the i-th factor found is the product of the factors
+    // of p of multiplicity i.
+    Polynomial dp = p.derivative(var);
+    Polynomial a = gcd(p, dp);
+    Polynomial b = divide_exact(p, a);
+    Polynomial d = subtract(divide_exact(dp, a), b.derivative(var));
+    for (int i = 1; b.degreeIn(var) > 0; i++)
+    {
+        a = gcd(b, d);
+        Polynomial next_c = divide_exact(d, a);
+        b = divide_exact(b, a);
+        d = subtract(next_c, b.derivative(var));
+        add_factor(a, multiplicity*i, factors);
+    }
+}
+
+// Adds the square-free factors of piece^multiplicity, or piece itself if
+// they can't be found exactly or in reasonable time.
+static void add_piece(const Polynomial& piece, int multiplicity, std::vector<Factor>* factors)
+{
+    std::vector<Factor> piece_factors;
+    try
+    {
+        if (piece.getMonomials().size() > MAX_GCD_MONOMIALS)
+            throw InexactException();
+        check_exact(piece);
+        square_free(piece, multiplicity, &piece_factors);
+    }
+    catch (InexactException)
+    {
+        piece_factors.clear();
+        Factor whole = { piece, multiplicity };
+        piece_factors.push_back(whole);
+    }
+
+    for (unsigned int j = 0; j < piece_factors.size(); j++)
+        add_factor(piece_factors[j].polynomial, piece_factors[j].multiplicity, factors);
+}
+
+std::vector<Factor> factorize(Term* f, const Polynomial& expanded)
+{
+    std::vector<Factor> pieces;
+    if (f->isProduct())
+        f->addFactors(1, &pieces);
+    else
+    {
+        Factor whole = { expanded, 1 };
+        pieces.push_back(whole);
+    }
+
+    std::vector<Factor> factors;
+    for (unsigned int i = 0; i < pieces.size(); i++)
+    {
+        if (pieces[i].multiplicity != 0)
+            add_piece(pieces[i].polynomial.homogenize(), pieces[i].multiplicity, &factors);
+    }
+    return factors;
+}
+
+std::vector<Factor> factorize(const Polynomial& f)
+{
+    std::vector<Factor> factors;
+    add_piece(f.homogenize(), 1, &factors);
+    return factors;
+}
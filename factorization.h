@@ -0,0 +1,44 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef FACTORIZATION_H
+#define FACTORIZATION_H
+
+#include <vector>
+
+#include "polynomial.h"
+
+class Term;
+
+// One factor of a function: f = (constant) * product of polynomial^multiplicity.
+struct Factor
+{
+    Polynomial polynomial;
+    int multiplicity;
+};
+
+// Splits the homogenization of f into square-free factors of positive
+// degree in x, y and z, with their multiplicities. Each is drawn as its own
+// curve: a factor squared never changes sign, so only the square-free part
+// shows up in marching squares, and factors of low degree are cheaper to
+// sample one by one than their product.
+//
+// f is split along the products and powers it was written with, then each
+// piece loses its monomial factors and its content in each variable, and
+// is put through Yun's square-free decomposition. That needs exact gcds,
+// which are computed with integer coefficients held in doubles; a piece
+// whose coefficients are not integers, or grow past what a double holds
+// exactly, or has too many monomials, is kept whole. Equal factors are
+// merged. expanded is f as a Polynomial; when f is not a product it is the
+// only piece, and is not expanded again.
+std::vector<Factor> factorize(Term* f, const Polynomial& expanded);
+// The same without the structural split, for polynomials that never were
+// Terms.
+std::vector<Factor> factorize(const Polynomial& f);
+
+#endif // FACTORIZATION_H
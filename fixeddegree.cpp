@@ -0,0 +1,75 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "fixeddegree.h"
+
+FixedDegreeBatch fixedDegreeBatch(int degree)
+{
+    static const FixedDegreeBatch evaluators[MAX_FIXED_DEGREE + 1] =
+    {
+        FixedDegree<0>::evalBatch,
+        FixedDegree<1>::evalBatch,
+        FixedDegree<2>::evalBatch,
+        FixedDegree<3>::evalBatch,
+        FixedDegree<4>::evalBatch,
+        FixedDegree<5>::evalBatch,
+        FixedDegree<6>::evalBatch,
+        FixedDegree<7>::evalBatch,
+        FixedDegree<8>::evalBatch
+    };
+
+    if (degree < 0 || degree > MAX_FIXED_DEGREE)
+        return 0;
+    return evaluators[degree];
+}
+
+bool fixedDegreeCoefficients(const Polynomial& p, int degree, std::vector<double>* coefficients)
+{
+    coefficients->assign((degree + 1)*(degree + 2)/2, 0.0);
+
+    const std::vector<Polynomial::Monomial>& monomials = p.getMonomials();
+    for (unsigned int k = 0; k < monomials.size(); k++)
+    {
+        const int* e = monomials[k].exponents;
+        if (e[Polynomial::VAR_Z] || e[Polynomial::VAR_S] || e[Polynomial::VAR_T])
+            return false;
+
+        int i = e[Polynomial::VAR_X];
+        int j = e[Polynomial::VAR_Y];
+        if (i + j > degree)
+            return false;
+
+        // The blocks for q_0 .. q_(i-1) hold degree + 1, degree, ... coefficients.
+        int offset = i*(degree + 1) - i*(i - 1)/2;
+        (*coefficients)[offset + j] = monomials[k].coefficient;
+    }
+
+    return true;
+}
+
+void evalWithGradient(const double* coefficients, int degree, double x, double y,
+                      double* value, double* d_dx, double* d_dy)
+{
+    double p = 0, p_x = 0, p_y = 0;
+    for (int i = degree; i >= 0; i--)
+    {
+        const double* c = coefficients + i*(degree + 1) - i*(i - 1)/2;
+        double q = 0, q_y = 0;
+        for (int j = degree - i; j >= 0; j--)
+        {
+            q_y = q_y*y + q;
+            q = q*y + c[j];
+        }
+        p_x = p_x*x + p;
+        p = p*x + q;
+        p_y = p_y*x + q_y;
+    }
+    *value = p;
+    *d_dx = p_x;
+    *d_dy = p_y;
+}
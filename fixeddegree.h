@@ -0,0 +1,102 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef FIXEDDEGREE_H
+#define FIXEDDEGREE_H
+
+#include <vector>
+
+#include "polynomial.h"
+
+// Evaluators for dense polynomials in x and y of a degree known at compile
+// time, which is what a curve of low degree becomes on an affine chart.
+// The coefficients sit in an array of fixed size and the nested Horner
+// scheme is unrolled completely by the templates below, leaving straight
+// line code with no loops or branches on the degree.
+//
+// Coefficient layout: p = sum over i of x^i q_i(y), where q_i has degree
+// Degree - i. The coefficients of q_0 come first, lowest power of y first,
+// then those of q_1, and so on.
+
+// Largest degree with a specialized evaluator.
+const int MAX_FIXED_DEGREE = 8;
+
+// c[0] + v*(c[1] + v*(... + v*c[N])).
+template<int N>
+inline double fixed_horner(const double* c, double v)
+{
+    return c[0] + v*fixed_horner<N - 1>(c + 1, v);
+}
+
+template<>
+inline double fixed_horner<0>(const double* c, double)
+{
+    return c[0];
+}
+
+// q_I(y) + x*(q_(I+1)(y) + x*(...)), with c pointing at q_I.
+template<int Degree, int I>
+struct FixedBivariateHorner
+{
+    static inline double eval(const double* c, double x, double y)
+    {
+        return fixed_horner<Degree - I>(c, y) + x*FixedBivariateHorner<Degree, I + 1>::eval(c + Degree - I + 1, x, y);
+    }
+};
+
+template<int Degree>
+struct FixedBivariateHorner<Degree, Degree>
+{
+    static inline double eval(const double* c, double, double)
+    {
+        return c[0];
+    }
+};
+
+template<int Degree>
+struct FixedDegree
+{
+    static const int NUM_COEFFICIENTS = (Degree + 1)*(Degree + 2)/2;
+
+    static inline double eval(const double* coefficients, double x, double y)
+    {
+        return FixedBivariateHorner<Degree, 0>::eval(coefficients, x, y);
+    }
+
+    static void evalBatch(const double* coefficients, const double* x, const double* y, double* out, int n)
+    {
+        // A local copy lets the compiler keep coefficients in registers
+        // rather than reloading them in case out aliases them.
+        double c[NUM_COEFFICIENTS];
+        for (int i = 0; i < NUM_COEFFICIENTS; i++)
+            c[i] = coefficients[i];
+
+        for (int i = 0; i < n; i++)
+            out[i] = eval(c, x[i], y[i]);
+    }
+};
+
+typedef void (*FixedDegreeBatch)(const double* coefficients, const double* x, const double* y, double* out, int n);
+
+// The evaluator for polynomials of total degree at most degree, or 0 if
+// degree is above MAX_FIXED_DEGREE.
+FixedDegreeBatch fixedDegreeBatch(int degree);
+
+// Lays out the coefficients of p, a polynomial in x and y only, as the
+// evaluator of the given degree expects them. Returns false if p has a
+// monomial of higher degree or involves z, s or t.
+bool fixedDegreeCoefficients(const Polynomial& p, int degree, std::vector<double>* coefficients);
+
+// Evaluates p, with coefficients laid out as above for the given degree,
+// at (x, y), along with its partial derivatives, by Horner's scheme with
+// derivatives: in y for each q_i, then in x. The degree need not have a
+// specialized evaluator.
+void evalWithGradient(const double* coefficients, int degree, double x, double y,
+                      double* value, double* d_dx, double* d_dy);
+
+#endif // FIXEDDEGREE_H
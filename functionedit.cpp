@@ -1,11 +1,15 @@
 #include "functionedit.h"
 
 #include <QColorDialog>
+#include <QCoreApplication>
 #include <QTimer>
 #include <QPalette>
 
 #include <iostream>
 
+#include "termtable.h"
+#include "stdecomposition.h"
+
 FunctionEdit::FunctionEdit(int index)
 {
     // I'm not content with these colors.
@@ -24,6 +28,10 @@ FunctionEdit::FunctionEdit(int index)
     f = 0;
     this->index = index;
 
+    // Run with --term-stats to print each parsed function, with its
+    // factors and how much hash-consing shares in it and its gradient.
+    print_term_stats = QCoreApplication::arguments().contains("--term-stats");
+
     // Set up GUI aspects...
 
     lineEdit = new QLineEdit();
@@ -51,19 +59,34 @@ void FunctionEdit::handleFunctionUpdate()
 {
     try
     {
-        if (f)
-            delete f;
-
-        Term* f_temp = Term::parseTerm(lineEdit->text().toStdString());
-        Term* f_temp2 = f_temp->simplify();
-        delete f_temp;
-
-        int degree = 0;
-        f = f_temp2->homogenize(&degree);
-        delete f_temp2;
+        f = 0;
 
-        f->print();
-        std::cout << std::endl;
+        // Both arenas keep their memory from the last keystroke, so after the
+        // first few edits parsing stops touching the heap at all.
+        int allocations_before = scratch_arena.numHeapAllocations() + function_arena.numHeapAllocations();
+        scratch_arena.reset();
+        function_arena.reset();
+
+        Term* f_parsed = Term::parseTerm(lineEdit->text().toStdString(), &scratch_arena);
+        Term* f_simplified = f_parsed->simplify(&scratch_arena);
+
+        // Expanded once, and used for homogenizing and for factoring where f
+        // is not a product.
+        Polynomial expanded(f_simplified);
+        Polynomial homogenized = expanded.homogenize();
+        f = homogenized.toTerm(&function_arena);
+        // Factored from the Term, while products the user typed are still
+        // products.
+        std::vector<Factor> factors = factorize(f_simplified, expanded);
+        for (unsigned int i = 0; i < factors.size(); i++)
+        {
+            if (factors[i].polynomial.degree() > MAX_CHART_DEGREE)
+                throw BadTermException("Factor of too high a degree to chart.");
+        }
+        function = std::make_shared<const CompiledFunction>(factors);
+
+        if (print_term_stats)
+            printTermStats(factors, allocations_before);
 
         QPalette palette = QPalette();
         palette.setColor(lineEdit->backgroundRole(), QColor::fromRgb(0xff, 0xff, 0xff));
@@ -81,9 +104,34 @@ void FunctionEdit::handleFunctionUpdate()
         lineEdit->setPalette(palette);
 
         f = 0;
+        function.reset();
     }
 }
 
+// Prints f, how parsing it went, its factors, and how many nodes f and
+// its gradient take as trees and once hash-consed.
+void FunctionEdit::printTermStats(const std::vector<Factor>& factors, int allocations_before)
+{
+    f->print();
+    std::cout << std::endl;
+    std::cout << "Parse: " << scratch_arena.numNodes() + function_arena.numNodes() << " nodes, "
+              << scratch_arena.numHeapAllocations() + function_arena.numHeapAllocations() - allocations_before
+              << " heap allocations." << std::endl;
+    std::cout << "Factors:";
+    for (unsigned int i = 0; i < factors.size(); i++)
+        std::cout << " degree " << factors[i].polynomial.degree() << "^" << factors[i].multiplicity;
+    std::cout << std::endl;
+
+    // Tree gradients are not built for comparison; they can be huge.
+    TermTable table;
+    Term* f_shared = table.intern(f);
+    std::cout << "Nodes: " << f->numNodes() << " as a tree, "
+              << table.numNodes(f_shared) << " interned. Gradient (interned): "
+              << table.numNodes(table.derivative(f_shared, 'x')) << ", "
+              << table.numNodes(table.derivative(f_shared, 'y')) << ", "
+              << table.numNodes(table.derivative(f_shared, 'z')) << "." << std::endl;
+}
+
 // Color button has been pressed.
 // Run a color dialog, then pass on the selected color to the Main Window.
 void FunctionEdit::handleColorButton()
@@ -103,3 +151,19 @@ void FunctionEdit::handleDeleteButton()
 {
     emit deleted(index);
 }
+
+void FunctionEdit::setLoadedFunction(const Polynomial& loaded, const std::vector<Factor>& factors, const QString& name)
+{
+    // There is no Term for it; the text shown is only a label.
+    f = 0;
+    function = std::make_shared<const CompiledFunction>(factors);
+    std::cout << "Loaded: " << loaded.getMonomials().size() << " monomials, degree "
+              << loaded.degree() << ", " << factors.size() << " factors." << std::endl;
+
+    lineEdit->blockSignals(true);
+    lineEdit->setText(name);
+    lineEdit->blockSignals(false);
+    lineEdit->setReadOnly(true);
+
+    emit functionUpdated(index);
+}
@@ -9,6 +9,7 @@
 #include <QVector3D>
 
 #include "term.h"
+#include "compiledfunction.h"
 
 class FunctionEdit : public QVBoxLayout
 {
@@ -18,8 +19,6 @@ public:
     FunctionEdit(int index);
     virtual ~FunctionEdit()
     {
-        if (f)
-            delete f;
         delete lineEdit;
         delete colorButton;
         delete deleteButton;
@@ -28,7 +27,14 @@ public:
 
     void setIndex(int new_index) { index = new_index; }
     int getIndex() { return index; }
-    Term* getFunctionClone() { return f->Clone(); }
+    // Shows a function that was not typed in, such as one loaded from a
+    // file, under the given name. factors are factorize(loaded), which the
+    // caller has checked against MAX_CHART_DEGREE. The line edit becomes
+    // read-only.
+    void setLoadedFunction(const Polynomial& loaded, const std::vector<Factor>& factors, const QString& name);
+    // The function as last parsed or loaded, to be shared rather than
+    // copied. Null if there is none.
+    const SharedFunction& getFunction() { return function; }
     QVector3D getColor() { return QVector3D(color.redF(), color.greenF(), color.blueF()); }
 
 signals:
@@ -42,9 +48,15 @@ private slots:
     void handleDeleteButton();
 
 private:
+    void printTermStats(const std::vector<Factor>& factors, int allocations_before);
+
     Term* f = 0;
+    SharedFunction function; // Of f, or loaded.
+    TermArena function_arena; // Holds f.
+    TermArena scratch_arena; // Holds the intermediate steps in building f.
     QColor color;
     int index;
+    bool print_term_stats = false;
 
     QLineEdit* lineEdit;
     QPushButton* colorButton;
@@ -0,0 +1,97 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "gridevaluator.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+double evalUniformGrid(const double* coefficients, int degree,
+                       double x_min, double x_step, int nx, double y_min, double y_step, int ny,
+                       double* out)
+{
+    // Scratch space, one set per thread and kept from call to call, so
+    // sampling does not allocate once it has seen the largest grid.
+    static thread_local std::vector<double> absolute_coefficients, y, row, absolute_row;
+
+    const int num_coefficients = (degree + 1)*(degree + 2)/2;
+    absolute_coefficients.resize(num_coefficients);
+    for (int c = 0; c < num_coefficients; c++)
+        absolute_coefficients[c] = std::abs(coefficients[c]);
+
+    y.resize(ny);
+    for (int j = 0; j < ny; j++)
+        y[j] = y_min + y_step*j;
+    double max_abs_y = std::max(std::abs(y[0]), std::abs(y[ny - 1]));
+
+    row.resize(degree + 1);
+    absolute_row.resize(degree + 1);
+    double max_bound = 0;
+
+    for (int i = 0; i < nx; i++)
+    {
+        // The coefficients of p on this row, as a polynomial in y, and of |p|
+        // at |x|. Running Horner's scheme in x for all of them at once keeps
+        // the chains independent.
+        double x = x_min + x_step*i;
+        std::fill(row.begin(), row.end(), 0.0);
+        std::fill(absolute_row.begin(), absolute_row.end(), 0.0);
+        for (int k = degree; k >= 0; k--)
+        {
+            // The block of x^k, as in fixedDegreeCoefficients.
+            int offset = k*(degree + 1) - k*(k - 1)/2;
+            for (int j = 0; j <= degree - k; j++)
+            {
+                row[j] = row[j]*x + coefficients[offset + j];
+                absolute_row[j] = absolute_row[j]*std::abs(x) + absolute_coefficients[offset + j];
+            }
+        }
+
+        double bound = 0;
+        for (int j = degree; j >= 0; j--)
+            bound = bound*max_abs_y + absolute_row[j];
+        max_bound = std::max(max_bound, bound);
+
+        // Four samples at a time, so that four Horner chains hide each
+        // other's latency.
+        double* row_out = out + i*ny;
+        int j = 0;
+        for (; j + 4 <= ny; j += 4)
+        {
+            double v0 = row[degree], v1 = v0, v2 = v0, v3 = v0;
+            for (int c = degree - 1; c >= 0; c--)
+            {
+                v0 = v0*y[j] + row[c];
+                v1 = v1*y[j + 1] + row[c];
+                v2 = v2*y[j + 2] + row[c];
+                v3 = v3*y[j + 3] + row[c];
+            }
+            row_out[j] = v0;
+            row_out[j + 1] = v1;
+            row_out[j + 2] = v2;
+            row_out[j + 3] = v3;
+        }
+        for (; j < ny; j++)
+        {
+            double v = row[degree];
+            for (int c = degree - 1; c >= 0; c--)
+                v = v*y[j] + row[c];
+            row_out[j] = v;
+        }
+    }
+
+    // Horner's scheme in x and then in y rounds at most 2*degree + 2 times
+    // along any path, each relative to the same schemes on |p|, which
+    // max_bound bounds. That bound was rounded too, hence the extra factor.
+    const double u = DBL_EPSILON/2;
+    const double n = 2.0*degree + 2;
+    const double gamma = n*u/(1 - n*u);
+    return gamma*(1 + gamma)*max_bound;
+}
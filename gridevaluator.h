@@ -0,0 +1,29 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef GRIDEVALUATOR_H
+#define GRIDEVALUATOR_H
+
+// Evaluation of a polynomial in x and y on a uniform grid. Along a row of
+// the grid x is fixed, so p restricted to the row is a polynomial of
+// degree d in y alone. Its d + 1 coefficients are found once per row, and
+// each sample then costs d multiply-adds however many terms p has, rather
+// than the full bivariate Horner scheme.
+
+// Below this degree the FixedDegree evaluators are faster per point.
+const int MIN_GRID_DEGREE = 5;
+
+// Evaluates p, with coefficients laid out as by fixedDegreeCoefficients
+// for the given degree, at x_min + i*x_step, y_min + j*y_step for
+// 0 <= i < nx and 0 <= j < ny, writing the value at (i, j) to
+// out[i*ny + j]. Returns a bound on the rounding error of any of the values.
+double evalUniformGrid(const double* coefficients, int degree,
+                       double x_min, double x_step, int nx, double y_min, double y_step, int ny,
+                       double* out);
+
+#endif // GRIDEVALUATOR_H
@@ -0,0 +1,77 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "interval.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Rounding to nearest is off by at most half an ulp, so stepping one
+// representable number outward is enough to contain the exact result.
+static Interval widen(double lo, double hi)
+{
+    return Interval(nextafter(lo, -INFINITY), nextafter(hi, INFINITY));
+}
+
+Interval Interval::operator+(const Interval& other) const
+{
+    return widen(lo + other.lo, hi + other.hi);
+}
+
+Interval Interval::operator-(const Interval& other) const
+{
+    return widen(lo - other.hi, hi - other.lo);
+}
+
+Interval Interval::operator*(const Interval& other) const
+{
+    double a = lo*other.lo;
+    double b = lo*other.hi;
+    double c = hi*other.lo;
+    double d = hi*other.hi;
+
+    return widen(std::min(std::min(a, b), std::min(c, d)),
+                 std::max(std::max(a, b), std::max(c, d)));
+}
+
+// base^exp for base >= 0, rounded down or up.
+static double pow_rounded(double base, int exp, bool up)
+{
+    double result = 1;
+    double direction = up ? INFINITY : 0;
+    while (exp)
+    {
+        if (exp & 1)
+            result = nextafter(result*base, direction);
+        exp >>= 1;
+        if (exp)
+            base = nextafter(base*base, direction);
+    }
+
+    return result;
+}
+
+Interval Interval::pow(int exp) const
+{
+    if (exp == 0)
+        return Interval(1);
+
+    if (exp % 2 == 0)
+    {
+        double mag_lo = std::min(fabs(lo), fabs(hi));
+        double mag_hi = std::max(fabs(lo), fabs(hi));
+        if (containsZero())
+            mag_lo = 0;
+        return Interval(pow_rounded(mag_lo, exp, false), pow_rounded(mag_hi, exp, true));
+    }
+
+    // Odd powers are increasing.
+    double new_lo = lo >= 0 ? pow_rounded(lo, exp, false) : -pow_rounded(-lo, exp, true);
+    double new_hi = hi >= 0 ? pow_rounded(hi, exp, true) : -pow_rounded(-hi, exp, false);
+    return Interval(new_lo, new_hi);
+}
@@ -0,0 +1,35 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+// A closed range [lo, hi] of doubles. Every operation rounds its result
+// outward by an ulp, so the true value of an expression over the inputs
+// is guaranteed to lie inside the computed interval.
+class Interval
+{
+public:
+    Interval(double value = 0) : lo(value), hi(value) {}
+    Interval(double lo, double hi) : lo(lo), hi(hi) {}
+
+    Interval operator+(const Interval& other) const;
+    Interval operator-(const Interval& other) const;
+    Interval operator*(const Interval& other) const;
+    // exp must be non-negative. Even powers are known to be non-negative,
+    // so [-1, 2]^2 is [0, 4] rather than [-2, 4].
+    Interval pow(int exp) const;
+
+    // Also true for NaN, as after inf - inf, since then nothing is known.
+    bool containsZero() const { return !(lo > 0 || hi < 0); }
+
+    double lo;
+    double hi;
+};
+
+#endif // INTERVAL_H
@@ -0,0 +1,496 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "jitterm.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define HAVE_JIT
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+#ifdef HAVE_JIT
+
+namespace {
+
+// General purpose registers, by encoding.
+enum { RAX = 0, RCX = 1, RDX = 2, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+       R8 = 8, R9 = 9, R10 = 10, R11 = 11 };
+const int NO_INDEX = -1;
+
+// SSE opcodes (the byte after 0x0F). Whether they act on one double or two
+// is decided by the prefix: 0xF2 for scalar, 0x66 for packed.
+enum { SSE_LOAD = 0x10, SSE_STORE = 0x11, SSE_UNPCKL = 0x14, SSE_MOVAPD = 0x28,
+       SSE_ADD = 0x58, SSE_MUL = 0x59, SSE_SUB = 0x5C };
+const unsigned char SCALAR = 0xF2;
+const unsigned char PACKED = 0x66;
+
+// Just enough of an x86-64 assembler for the code CompiledTerm needs.
+// Memory operands are always [base + index + disp32].
+class Assembler
+{
+public:
+    std::vector<unsigned char> bytes;
+
+    void byte(unsigned char b) { bytes.push_back(b); }
+
+    void dword(int d)
+    {
+        for (int i = 0; i < 4; i++)
+            byte((d >> (8*i)) & 0xff);
+    }
+
+    void rex(bool w, int reg, int index, int base, bool force = false)
+    {
+        unsigned char r = 0x40 | (w ? 8 : 0) | ((reg >> 3) << 2) | ((index >= 0 ? index >> 3 : 0) << 1) | (base >> 3);
+        if (r != 0x40 || force)
+            byte(r);
+    }
+
+    void modrmMemory(int reg, int base, int index, int disp)
+    {
+        if (index != NO_INDEX || (base & 7) == RSP)
+        {
+            byte(0x80 | ((reg & 7) << 3) | 4);
+            byte(((index != NO_INDEX ? index & 7 : 4) << 3) | (base & 7));
+        }
+        else
+            byte(0x80 | ((reg & 7) << 3) | (base & 7));
+        dword(disp);
+    }
+
+    // op xmm, [base + index + disp] (or the reverse, for stores).
+    void sseMemory(unsigned char prefix, unsigned char op, int xmm, int base, int index, int disp)
+    {
+        byte(prefix);
+        rex(false, xmm, index, base);
+        byte(0x0F);
+        byte(op);
+        modrmMemory(xmm, base, index, disp);
+    }
+
+    // op dst, src on xmm registers.
+    void sseRegister(unsigned char prefix, unsigned char op, int dst, int src)
+    {
+        byte(prefix);
+        rex(false, dst, NO_INDEX, src);
+        byte(0x0F);
+        byte(op);
+        byte(0xC0 | ((dst & 7) << 3) | (src & 7));
+    }
+
+    // mov reg, [base + disp]
+    void loadQword(int reg, int base, int disp)
+    {
+        rex(true, reg, NO_INDEX, base);
+        byte(0x8B);
+        modrmMemory(reg, base, NO_INDEX, disp);
+    }
+
+    // mov dst, src
+    void movRegister(int dst, int src)
+    {
+        rex(true, src, NO_INDEX, dst);
+        byte(0x89);
+        byte(0xC0 | ((src & 7) << 3) | (dst & 7));
+    }
+
+    // Loads a double constant into xmm through a general purpose register.
+    void loadConstant(int xmm, double val, int scratch)
+    {
+        long long bits;
+        memcpy(&bits, &val, sizeof(bits));
+
+        // mov scratch, imm64
+        rex(true, 0, NO_INDEX, scratch);
+        byte(0xB8 | (scratch & 7));
+        dword((int)(bits & 0xffffffff));
+        dword((int)(bits >> 32));
+
+        // movq xmm, scratch
+        byte(0x66);
+        rex(true, xmm, NO_INDEX, scratch);
+        byte(0x0F);
+        byte(0x6E);
+        byte(0xC0 | ((xmm & 7) << 3) | (scratch & 7));
+    }
+
+    void prologue(int frame_size)
+    {
+        byte(0x55);                      // push rbp
+        movRegister(RBP, RSP);           // mov rbp, rsp
+        rex(true, 0, NO_INDEX, RSP);     // sub rsp, frame_size
+        byte(0x81);
+        byte(0xEC);
+        dword(frame_size);
+    }
+
+    void epilogue()
+    {
+        movRegister(RSP, RBP);           // mov rsp, rbp
+        byte(0x5D);                      // pop rbp
+        byte(0xC3);                      // ret
+    }
+};
+
+// Register holding the first integer argument.
+#ifdef _WIN32
+const int FIRST_ARGUMENT = RCX;
+#else
+const int FIRST_ARGUMENT = RDI;
+#endif
+
+// Computes xmm0 = xmm1^exponent, with the exponent known now.
+// Clobbers xmm1 and, for a zero exponent, scratch.
+void emit_powi(Assembler* a, unsigned char prefix, int exponent, int scratch)
+{
+    if (exponent == 0)
+    {
+        a->loadConstant(0, 1.0, scratch);
+        if (prefix == PACKED)
+            a->sseRegister(PACKED, SSE_UNPCKL, 0, 0);
+        return;
+    }
+
+    bool have_result = false;
+    for (int e = exponent; e; e >>= 1)
+    {
+        if (e & 1)
+        {
+            if (have_result)
+                a->sseRegister(prefix, SSE_MUL, 0, 1);
+            else
+                a->sseRegister(PACKED, SSE_MOVAPD, 0, 1);
+            have_result = true;
+        }
+        if (e >> 1)
+            a->sseRegister(prefix, SSE_MUL, 1, 1);
+    }
+}
+
+// Emits xmm0 = a op b for registers in the stack frame, slot bytes apart.
+// in_xmm0 is the register whose value xmm0 still holds from the previous
+// instruction, or -1; that operand is not reloaded. The stack frame is
+// 16-byte aligned, so packed operations can take their operand from memory.
+void emit_binary(Assembler* a, unsigned char prefix, unsigned char op, int lhs, int rhs, int slot, int in_xmm0)
+{
+    bool commutes = op != SSE_SUB;
+
+    if (lhs == in_xmm0)
+        a->sseMemory(prefix, op, 0, RSP, NO_INDEX, slot*rhs);
+    else if (rhs == in_xmm0 && commutes)
+        a->sseMemory(prefix, op, 0, RSP, NO_INDEX, slot*lhs);
+    else if (rhs == in_xmm0)
+    {
+        a->sseRegister(PACKED, SSE_MOVAPD, 1, 0);
+        a->sseMemory(prefix, SSE_LOAD, 0, RSP, NO_INDEX, slot*lhs);
+        a->sseRegister(prefix, op, 0, 1);
+    }
+    else
+    {
+        a->sseMemory(prefix, SSE_LOAD, 0, RSP, NO_INDEX, slot*lhs);
+        a->sseMemory(prefix, op, 0, RSP, NO_INDEX, slot*rhs);
+    }
+}
+
+// Scalar entry: double f(const double vars[5]).
+// The register file lives on the stack, 8 bytes per register.
+void emit_scalar(Assembler* a, CompiledTerm* program)
+{
+    const std::vector<CompiledTerm::Instruction>& code = program->getCode();
+    const std::vector<double>& constants = program->getConstants();
+    int frame_size = (program->numRegisters()*8 + 15) & ~15;
+
+    a->prologue(frame_size);
+
+    int in_xmm0 = -1;
+    for (unsigned int i = 0; i < code.size(); i++)
+    {
+        const CompiledTerm::Instruction& instr = code[i];
+        switch (instr.op)
+        {
+        case CompiledTerm::OP_LOAD_VAR:
+            a->sseMemory(SCALAR, SSE_LOAD, 0, FIRST_ARGUMENT, NO_INDEX, 8*instr.a);
+            break;
+        case CompiledTerm::OP_LOAD_CONST:
+            a->loadConstant(0, constants[instr.a], RAX);
+            break;
+        case CompiledTerm::OP_ADD:
+        case CompiledTerm::OP_SUB:
+        case CompiledTerm::OP_MUL:
+        {
+            unsigned char op = instr.op == CompiledTerm::OP_ADD ? SSE_ADD :
+                               instr.op == CompiledTerm::OP_SUB ? SSE_SUB : SSE_MUL;
+            emit_binary(a, SCALAR, op, instr.a, instr.b, 8, in_xmm0);
+            break;
+        }
+        case CompiledTerm::OP_POWI:
+            if (instr.a == in_xmm0)
+                a->sseRegister(PACKED, SSE_MOVAPD, 1, 0);
+            else
+                a->sseMemory(SCALAR, SSE_LOAD, 1, RSP, NO_INDEX, 8*instr.a);
+            emit_powi(a, SCALAR, instr.b, RAX);
+            break;
+        }
+        a->sseMemory(SCALAR, SSE_STORE, 0, RSP, NO_INDEX, 8*instr.dest);
+        in_xmm0 = instr.dest;
+    }
+
+    // The result is returned in xmm0.
+    if (in_xmm0 != program->resultRegister())
+        a->sseMemory(SCALAR, SSE_LOAD, 0, RSP, NO_INDEX, 8*program->resultRegister());
+    a->epilogue();
+}
+
+// Batch entry: void f(const Args* args), for an even args->n.
+// Each register holds two lanes, 16 bytes per register.
+// Only caller-saved registers are used (rax, rcx, rdx, r8-r11, xmm0-xmm3),
+// so this suits both the System V and Windows calling conventions.
+void emit_batch(Assembler* a, CompiledTerm* program, int x_offset, int y_offset, int z_offset,
+                int st_offset, int out_offset, int n_offset)
+{
+    const std::vector<CompiledTerm::Instruction>& code = program->getCode();
+    const std::vector<double>& constants = program->getConstants();
+    int frame_size = program->numRegisters()*16;
+    const int var_base[3] = { R8, R9, R10 };
+
+    a->prologue(frame_size);
+
+    a->movRegister(R11, FIRST_ARGUMENT);
+    a->loadQword(R8, R11, x_offset);
+    a->loadQword(R9, R11, y_offset);
+    a->loadQword(R10, R11, z_offset);
+    a->loadQword(RCX, R11, st_offset);
+    a->loadQword(RDX, R11, out_offset);
+    a->loadQword(R11, R11, n_offset);
+
+    // s and t are the same for every point, so keep them in xmm2 and xmm3.
+    // That frees rcx to be the scratch register for constants.
+    a->sseMemory(SCALAR, SSE_LOAD, 2, RCX, NO_INDEX, 0);
+    a->sseRegister(PACKED, SSE_UNPCKL, 2, 2);
+    a->sseMemory(SCALAR, SSE_LOAD, 3, RCX, NO_INDEX, 8);
+    a->sseRegister(PACKED, SSE_UNPCKL, 3, 3);
+
+    // shl r11, 3: the loop runs over byte offsets.
+    a->rex(true, 0, NO_INDEX, R11);
+    a->byte(0xC1);
+    a->byte(0xE3);
+    a->byte(3);
+
+    // xor eax, eax
+    a->byte(0x31);
+    a->byte(0xC0);
+
+    // test r11, r11; jz done
+    a->rex(true, R11, NO_INDEX, R11);
+    a->byte(0x85);
+    a->byte(0xDB);
+    a->byte(0x0F);
+    a->byte(0x84);
+    int skip_loop_patch = a->bytes.size();
+    a->dword(0);
+
+    int loop_start = a->bytes.size();
+
+    int in_xmm0 = -1;
+    for (unsigned int i = 0; i < code.size(); i++)
+    {
+        const CompiledTerm::Instruction& instr = code[i];
+        switch (instr.op)
+        {
+        case CompiledTerm::OP_LOAD_VAR:
+            if (instr.a < 3)
+                a->sseMemory(PACKED, SSE_LOAD, 0, var_base[instr.a], RAX, 0);
+            else
+                a->sseRegister(PACKED, SSE_MOVAPD, 0, instr.a == 3 ? 2 : 3);
+            break;
+        case CompiledTerm::OP_LOAD_CONST:
+            a->loadConstant(0, constants[instr.a], RCX);
+            a->sseRegister(PACKED, SSE_UNPCKL, 0, 0);
+            break;
+        case CompiledTerm::OP_ADD:
+        case CompiledTerm::OP_SUB:
+        case CompiledTerm::OP_MUL:
+        {
+            unsigned char op = instr.op == CompiledTerm::OP_ADD ? SSE_ADD :
+                               instr.op == CompiledTerm::OP_SUB ? SSE_SUB : SSE_MUL;
+            emit_binary(a, PACKED, op, instr.a, instr.b, 16, in_xmm0);
+            break;
+        }
+        case CompiledTerm::OP_POWI:
+            if (instr.a == in_xmm0)
+                a->sseRegister(PACKED, SSE_MOVAPD, 1, 0);
+            else
+                a->sseMemory(PACKED, SSE_LOAD, 1, RSP, NO_INDEX, 16*instr.a);
+            emit_powi(a, PACKED, instr.b, RCX);
+            break;
+        }
+        a->sseMemory(PACKED, SSE_STORE, 0, RSP, NO_INDEX, 16*instr.dest);
+        in_xmm0 = instr.dest;
+    }
+
+    if (in_xmm0 != program->resultRegister())
+        a->sseMemory(PACKED, SSE_LOAD, 0, RSP, NO_INDEX, 16*program->resultRegister());
+    a->sseMemory(PACKED, SSE_STORE, 0, RDX, RAX, 0);
+
+    // add rax, 16
+    a->rex(true, 0, NO_INDEX, RAX);
+    a->byte(0x83);
+    a->byte(0xC0);
+    a->byte(16);
+
+    // cmp rax, r11; jb loop_start
+    a->rex(true, R11, NO_INDEX, RAX);
+    a->byte(0x39);
+    a->byte(0xD8);
+    a->byte(0x0F);
+    a->byte(0x82);
+    a->dword(loop_start - ((int)a->bytes.size() + 4));
+
+    int done = a->bytes.size();
+    int rel = done - (skip_loop_patch + 4);
+    memcpy(&a->bytes[skip_loop_patch], &rel, 4);
+
+    a->epilogue();
+}
+
+} // namespace
+
+#endif // HAVE_JIT
+
+bool JitTerm::isAvailable()
+{
+#ifdef HAVE_JIT
+    return true;
+#else
+    return false;
+#endif
+}
+
+JitTerm* JitTerm::compile(CompiledTerm* program)
+{
+#ifdef HAVE_JIT
+    Assembler a;
+    emit_scalar(&a, program);
+
+    // Start the batch entry on a fresh cache line.
+    while (a.bytes.size() % 64)
+        a.byte(0xCC);
+    int batch_start = a.bytes.size();
+    emit_batch(&a, program, offsetof(Args, x), offsetof(Args, y), offsetof(Args, z),
+               offsetof(Args, st), offsetof(Args, out), offsetof(Args, n));
+
+    int size = (a.bytes.size() + 4095) & ~4095;
+
+    // Written while writable, then flipped to executable, so the page is
+    // never both at once.
+#ifdef _WIN32
+    void* memory = VirtualAlloc(0, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+    if (!memory)
+        return 0;
+    memcpy(memory, a.bytes.data(), a.bytes.size());
+    DWORD old_protection;
+    if (!VirtualProtect(memory, size, PAGE_EXECUTE_READ, &old_protection))
+    {
+        VirtualFree(memory, 0, MEM_RELEASE);
+        return 0;
+    }
+#else
+    void* memory = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+        return 0;
+    memcpy(memory, a.bytes.data(), a.bytes.size());
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, size);
+        return 0;
+    }
+#endif
+
+    JitTerm* jit = new JitTerm();
+    jit->memory = memory;
+    jit->memory_size = size;
+    jit->code_size = a.bytes.size();
+    jit->scalar_entry = (ScalarFunction)memory;
+    jit->batch_entry = (BatchFunction)((char*)memory + batch_start);
+    return jit;
+#else
+    (void)program;
+    return 0;
+#endif
+}
+
+JitTerm::~JitTerm()
+{
+#ifdef HAVE_JIT
+#ifdef _WIN32
+    VirtualFree(memory, 0, MEM_RELEASE);
+#else
+    munmap(memory, memory_size);
+#endif
+#endif
+}
+
+double JitTerm::eval(double x, double y, double z, double s, double t) const
+{
+    const double vars[5] = { x, y, z, s, t };
+    return scalar_entry(vars);
+}
+
+void JitTerm::evalBatch(const double* x, const double* y, const double* z, double s, double t, double* out, int n) const
+{
+    const double st[2] = { s, t };
+    Args args = { x, y, z, st, out, n & ~1 };
+    batch_entry(&args);
+
+    // The machine code does pairs; an odd point out goes through the scalar entry.
+    if (n & 1)
+        out[n - 1] = eval(x[n - 1], y[n - 1], z[n - 1], s, t);
+}
+
+bool JitTerm::verify(Term* f, int num_points, double tolerance, double* max_error)
+{
+    std::vector<double> x(num_points), y(num_points), z(num_points), batch_out(num_points);
+    double worst = 0;
+
+    for (int i = 0; i < num_points; i++)
+    {
+        x[i] = 2.0*rand()/RAND_MAX - 1;
+        y[i] = 2.0*rand()/RAND_MAX - 1;
+        z[i] = 2.0*rand()/RAND_MAX - 1;
+    }
+    double s = 2.0*rand()/RAND_MAX - 1;
+    double t = 2.0*rand()/RAND_MAX - 1;
+
+    evalBatch(x.data(), y.data(), z.data(), s, t, batch_out.data(), num_points);
+
+    for (int i = 0; i < num_points; i++)
+    {
+        double expected = f->eval(x[i], y[i], z[i], s, t);
+        double scale = fabs(expected) > 1 ? fabs(expected) : 1;
+        double scalar_error = fabs(eval(x[i], y[i], z[i], s, t) - expected) / scale;
+        double batch_error = fabs(batch_out[i] - expected) / scale;
+        if (!(scalar_error <= worst))
+            worst = scalar_error;
+        if (!(batch_error <= worst))
+            worst = batch_error;
+    }
+
+    if (max_error)
+        *max_error = worst;
+    return worst <= tolerance;
+}
@@ -0,0 +1,66 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef JITTERM_H
+#define JITTERM_H
+
+#include "term.h"
+#include "compiledterm.h"
+
+// A CompiledTerm translated into x86-64 machine code at runtime.
+// The code is written by hand into a page of executable memory; there is
+// no external compiler involved. Only available on x86-64, elsewhere
+// compile() returns 0 and callers should keep using the CompiledTerm.
+class JitTerm
+{
+public:
+    // Returns 0 if this platform has no JIT.
+    // Warning: allocates a new JitTerm.
+    static JitTerm* compile(CompiledTerm* program);
+    static bool isAvailable();
+    ~JitTerm();
+
+    // Scalar entry point: one point, scalar SSE2 arithmetic.
+    double eval(double x, double y, double z, double s, double t) const;
+
+    // Vectorized entry point: two points per iteration with packed SSE2.
+    // Same contract as CompiledTerm::evalBatch.
+    void evalBatch(const double* x, const double* y, const double* z, double s, double t, double* out, int n) const;
+
+    // Compares eval and evalBatch against f->eval at num_points random
+    // points in [-1, 1]^5. Returns true if every relative error is within
+    // tolerance; the worst one found is written to max_error.
+    bool verify(Term* f, int num_points, double tolerance, double* max_error = 0);
+
+    int codeSize() const { return code_size; }
+
+private:
+    JitTerm() {}
+
+    // Layout of the single argument both entry points take.
+    struct Args
+    {
+        const double* x;
+        const double* y;
+        const double* z;
+        const double* st;
+        double* out;
+        long long n;
+    };
+
+    typedef double (*ScalarFunction)(const double* vars);
+    typedef void (*BatchFunction)(const Args* args);
+
+    void* memory = 0;
+    int memory_size = 0;
+    int code_size = 0;
+    ScalarFunction scalar_entry = 0;
+    BatchFunction batch_entry = 0;
+};
+
+#endif // JITTERM_H
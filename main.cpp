@@ -17,11 +17,34 @@
  */
 
 #include "mainwindow.h"
+#include "benchmark.h"
 #include <QApplication>
 
 int main(int argc, char *argv[])
 {
     QApplication a(argc, argv);
+
+    if (a.arguments().contains("--benchmark-parser"))
+    {
+        runParserBenchmark();
+        return 0;
+    }
+    if (a.arguments().contains("--benchmark-evaluators"))
+    {
+        runEvaluatorBenchmark();
+        return 0;
+    }
+    if (a.arguments().contains("--benchmark-gradient"))
+    {
+        runGradientBenchmark();
+        return 0;
+    }
+    if (a.arguments().contains("--benchmark-charting"))
+    {
+        runChartingBenchmark();
+        return 0;
+    }
+
     MainWindow w;
     w.show();
 
@@ -9,10 +9,18 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <QColorDialog>
 #include <QMessageBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QProgressDialog>
+
+#include "polynomialfile.h"
+#include "factorization.h"
+#include "stdecomposition.h"
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -26,6 +34,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->sidebarVerticalLayout->setStretch(0, 1); // Stretch the curves part to fill sidebar.
 
     connect(ui->addCurveButton, SIGNAL(pressed()), this, SLOT(handleAddCurveButton()));
+    connect(ui->actionLoad_Curve, SIGNAL(triggered(bool)), this, SLOT(handleLoadCurve(bool)));
     connect(ui->actionAbout, SIGNAL(triggered(bool)), this, SLOT(handleAbout(bool)));
     connect(ui->actionQuick_Start_Guide, SIGNAL(triggered(bool)), this, SLOT(handleQuickStartMessage(bool)));
 
@@ -65,9 +74,57 @@ void MainWindow::handleAddCurveButton()
     render_area->addFunction(fe->getColor());
 }
 
+// Adds a curve whose polynomial is read from a file. Files too big to type
+// are parsed straight from disk, with a progress dialog that can cancel.
+// Curves with a factor above MAX_CHART_DEGREE are refused before they
+// reach the render area, which would chart them on every pan and zoom.
+void MainWindow::handleLoadCurve(bool t)
+{
+    QString path = QFileDialog::getOpenFileName(this, "Load Curve from File");
+    if (path.isEmpty())
+        return;
+
+    QString name = QFileInfo(path).fileName();
+    QProgressDialog progress("Loading " + name + "...", "Cancel", 0, 1000, this);
+    progress.setWindowModality(Qt::WindowModal);
+    progress.setMinimumDuration(500);
+
+    try
+    {
+        Polynomial f = loadPolynomialFile(path, [&progress](long long done, long long total)
+        {
+            progress.setValue((int)(1000*done/total));
+            return !progress.wasCanceled();
+        });
+
+        std::vector<Factor> factors = factorize(f);
+        int degree = 0;
+        for (unsigned int i = 0; i < factors.size(); i++)
+            degree = std::max(degree, factors[i].polynomial.degree());
+        if (degree > MAX_CHART_DEGREE)
+        {
+            QMessageBox::warning(this, "Load Curve from File",
+                                 name + QString(": a factor has degree %1, and curves can be drawn up to degree %2.")
+                                 .arg(degree).arg(MAX_CHART_DEGREE));
+            return;
+        }
+
+        handleAddCurveButton();
+        functionEdits.back()->setLoadedFunction(f, factors, name);
+    }
+    catch (LoadCancelledException)
+    {
+    }
+    catch (BadTermException bte)
+    {
+        QMessageBox::warning(this, "Load Curve from File", name + ": " + bte.getErrorMessage());
+    }
+}
+
 void MainWindow::handleFunctionUpdate(int index)
 {
-    render_area->setFunction(index, functionEdits[index]->getFunctionClone());
+    // The render area shares the function; nothing is copied.
+    render_area->setFunction(index, functionEdits[index]->getFunction());
     render_area->update();
 }
 
@@ -114,7 +171,9 @@ void MainWindow::handleQuickStartMessage(bool t)
     QMessageBox::about(this, "Quick Start Guide",
                        "Enter a polynomial in x, y, and z to display its zero locus. "
                        "Parentheses, integer expressions, and the symbols +, -, ^, * are supported. "
-                       "Polynomials are automatically homogenized by adding multiples of z. \n\n"
+                       "Polynomials are automatically homogenized by adding multiples of z. "
+                       "Polynomials too long to type can be loaded from a text file "
+                       "with File > Load Curve from File. \n\n"
                        "Click and drag to view different parts of the curve. "
                        "Zoom in and out with the mouse wheel. \n\n"
                        "In addition, there is a projective parameter [s : t] for animating "
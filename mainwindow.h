@@ -28,6 +28,7 @@ public:
 
 private slots:
     void handleAddCurveButton();
+    void handleLoadCurve(bool t);
     void handleFunctionUpdate(int index);
     void handleFunctionColorUpdate(int index);
     void handleFunctionDeletePressed(int index);
@@ -10,27 +10,45 @@
 
 #include <iostream>
 
-NumericalTerm::NumericalTerm(int val)
+#include "polynomial.h"
+#include "termtable.h"
+
+NumericalTerm::NumericalTerm(double val)
 {
     this->val = val;
 }
 
-double NumericalTerm::eval(double x, double y, double z, double s, double t)
+double NumericalTerm::eval(double x, double y, double z, double s, double t) const
 {
     return val;
 }
 
-Term* NumericalTerm::derivative(char var)
+Interval NumericalTerm::evalInterval(const Interval& x, const Interval& y, const Interval& z, double s, double t) const
 {
-    return new NumericalTerm(0);
+    return Interval(val);
 }
 
-Term* NumericalTerm::Clone()
+Term* NumericalTerm::derivative(char var, TermArena* arena)
 {
-    return new NumericalTerm(val);
+    return new (arena) NumericalTerm(0);
+}
+
+Term* NumericalTerm::Clone(TermArena* arena)
+{
+    return new (arena) NumericalTerm(val);
 }
 
 void NumericalTerm::print()
 {
     std::cout << val;
 }
+
+Polynomial NumericalTerm::toPolynomial()
+{
+    return Polynomial(val);
+}
+
+Term* NumericalTerm::intern(TermTable* table)
+{
+    return table->number(val);
+}
@@ -14,21 +14,24 @@
 class NumericalTerm : public Term
 {
 public:
-    NumericalTerm(int val);
+    NumericalTerm(double val);
 
-    virtual double eval(double x, double y, double z, double s, double t);
-    virtual Term* derivative(char var);
+    virtual double eval(double x, double y, double z, double s, double t) const;
+    virtual Interval evalInterval(const Interval& x, const Interval& y, const Interval& z, double s, double t) const;
+    virtual Term* derivative(char var, TermArena* arena);
     virtual void print();
-    virtual Term* Clone();
+    virtual Term* Clone(TermArena* arena);
 
     virtual bool isZero() {return val == 0; }
     virtual bool isOne() {return val == 1; }
     virtual bool isNumerical() {return true; }
-    virtual Term* homogenize(int* degree) { *degree = 0;
-                                            return Clone(); }
-    int getIntegralValue() { return val; }
+    virtual Polynomial toPolynomial();
+    virtual Term* intern(TermTable* table);
+    int getIntegralValue() const { return (int)val; }
 private:
-    int val;
+    // Always integral, but kept as a double since expanded coefficients
+    // quickly outgrow an int.
+    double val;
 
 };
 
@@ -0,0 +1,622 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "polynomial.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "term.h"
+#include "numericalterm.h"
+#include "variable.h"
+#include "binaryop.h"
+#include "compiledterm.h"
+
+static bool exponents_greater(const Polynomial::Monomial& a, const Polynomial::Monomial& b)
+{
+    for (int v = 0; v < Polynomial::NUM_VARS; v++)
+    {
+        if (a.exponents[v] != b.exponents[v])
+            return a.exponents[v] > b.exponents[v];
+    }
+    return false;
+}
+
+static bool exponents_equal(const Polynomial::Monomial& a, const Polynomial::Monomial& b)
+{
+    for (int v = 0; v < Polynomial::NUM_VARS; v++)
+    {
+        if (a.exponents[v] != b.exponents[v])
+            return false;
+    }
+    return true;
+}
+
+Polynomial::Polynomial(double constant)
+{
+    if (constant != 0)
+    {
+        Monomial m = { { 0, 0, 0, 0, 0 }, constant };
+        monomials.push_back(m);
+    }
+}
+
+Polynomial::Polynomial(const std::vector<Monomial>& monomials) : monomials(monomials)
+{
+    normalize();
+}
+
+Polynomial::Polynomial(Term* f)
+{
+    *this = f->toPolynomial();
+}
+
+Polynomial Polynomial::variable(int var)
+{
+    Polynomial result(1.0);
+    result.monomials[0].exponents[var] = 1;
+    return result;
+}
+
+void Polynomial::normalize()
+{
+    std::sort(monomials.begin(), monomials.end(), exponents_greater);
+
+    // Merge runs with equal exponents, dropping anything that cancels.
+    unsigned int out = 0;
+    for (unsigned int i = 0; i < monomials.size();)
+    {
+        Monomial m = monomials[i];
+        for (i++; i < monomials.size() && exponents_equal(monomials[i], m); i++)
+            m.coefficient += monomials[i].coefficient;
+
+        if (m.coefficient != 0)
+            monomials[out++] = m;
+    }
+    monomials.resize(out);
+}
+
+Polynomial Polynomial::operator+(const Polynomial& other) const
+{
+    Polynomial result;
+    result.monomials.reserve(monomials.size() + other.monomials.size());
+    result.monomials = monomials;
+    result.monomials.insert(result.monomials.end(), other.monomials.begin(), other.monomials.end());
+    result.normalize();
+    return result;
+}
+
+Polynomial Polynomial::operator-(const Polynomial& other) const
+{
+    Polynomial negated = other;
+    for (unsigned int i = 0; i < negated.monomials.size(); i++)
+        negated.monomials[i].coefficient = -negated.monomials[i].coefficient;
+    return *this + negated;
+}
+
+Polynomial Polynomial::operator*(const Polynomial& other) const
+{
+    Polynomial result;
+    result.monomials.reserve(monomials.size() * other.monomials.size());
+
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        for (unsigned int j = 0; j < other.monomials.size(); j++)
+        {
+            Monomial m;
+            for (int v = 0; v < NUM_VARS; v++)
+                m.exponents[v] = monomials[i].exponents[v] + other.monomials[j].exponents[v];
+            m.coefficient = monomials[i].coefficient * other.monomials[j].coefficient;
+            result.monomials.push_back(m);
+        }
+    }
+
+    result.normalize();
+    return result;
+}
+
+// We assume that exponent is non-negative.
+Polynomial Polynomial::pow(int exponent) const
+{
+    Polynomial result(1.0);
+    Polynomial base = *this;
+    while (exponent)
+    {
+        if (exponent & 1)
+            result = result * base;
+        exponent >>= 1;
+        if (exponent)
+            base = base * base;
+    }
+
+    return result;
+}
+
+int Polynomial::degree() const
+{
+    int max_degree = 0;
+    for (unsigned int i = 0; i < monomials.size(); i++)
+        max_degree = std::max(max_degree, monomials[i].degree());
+    return max_degree;
+}
+
+bool Polynomial::operator==(const Polynomial& other) const
+{
+    if (monomials.size() != other.monomials.size())
+        return false;
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        if (!exponents_equal(monomials[i], other.monomials[i]) || monomials[i].coefficient != other.monomials[i].coefficient)
+            return false;
+    }
+    return true;
+}
+
+int Polynomial::degreeIn(int var) const
+{
+    int max_degree = 0;
+    for (unsigned int i = 0; i < monomials.size(); i++)
+        max_degree = std::max(max_degree, monomials[i].exponents[var]);
+    return max_degree;
+}
+
+Polynomial Polynomial::coefficientOf(int var, int power) const
+{
+    Polynomial result;
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        if (monomials[i].exponents[var] == power)
+        {
+            result.monomials.push_back(monomials[i]);
+            result.monomials.back().exponents[var] = 0;
+        }
+    }
+    // Dropping a variable keeps the order.
+    return result;
+}
+
+Polynomial Polynomial::derivative(int var) const
+{
+    Polynomial result;
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        if (monomials[i].exponents[var] > 0)
+        {
+            Monomial m = monomials[i];
+            m.coefficient *= m.exponents[var];
+            m.exponents[var]--;
+            result.monomials.push_back(m);
+        }
+    }
+    return result;
+}
+
+bool Polynomial::isHomogeneous() const
+{
+    int d = degree();
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        if (monomials[i].degree() != d)
+            return false;
+    }
+    return true;
+}
+
+Polynomial Polynomial::homogenize() const
+{
+    int d = degree();
+    Polynomial result = *this;
+    for (unsigned int i = 0; i < result.monomials.size(); i++)
+        result.monomials[i].exponents[VAR_Z] += d - result.monomials[i].degree();
+    result.normalize();
+    return result;
+}
+
+Polynomial Polynomial::transformed(const double map[3][3]) const
+{
+    // powers[v][e] is the e-th power of the form substituted for variable v,
+    // computed as needed and shared by every monomial.
+    std::vector<Polynomial> powers[3];
+    for (int v = 0; v < 3; v++)
+    {
+        Polynomial form;
+        for (int w = 0; w < 3; w++)
+            form = form + Polynomial(map[v][w])*variable(w);
+        powers[v].push_back(Polynomial(1.0));
+        powers[v].push_back(form);
+    }
+
+    Polynomial result;
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        const Monomial& m = monomials[i];
+        Polynomial product(m.coefficient);
+        for (int v = 0; v < 3; v++)
+        {
+            while ((int)powers[v].size() <= m.exponents[v])
+                powers[v].push_back(powers[v].back()*powers[v][1]);
+            product = product*powers[v][m.exponents[v]];
+        }
+
+        // Put s and t back; the forms don't involve them.
+        for (unsigned int j = 0; j < product.monomials.size(); j++)
+        {
+            product.monomials[j].exponents[VAR_S] = m.exponents[VAR_S];
+            product.monomials[j].exponents[VAR_T] = m.exponents[VAR_T];
+        }
+
+        // Merged once at the end, rather than after every monomial.
+        result.monomials.insert(result.monomials.end(), product.monomials.begin(), product.monomials.end());
+    }
+
+    result.normalize();
+    return result;
+}
+
+Polynomial Polynomial::dehomogenized() const
+{
+    Polynomial result = *this;
+    for (unsigned int i = 0; i < result.monomials.size(); i++)
+        result.monomials[i].exponents[VAR_Z] = 0;
+    result.normalize();
+    return result;
+}
+
+// Multiplies p, a polynomial in x and y of degree e < d stored densely
+// with x^i y^j at i*(d + 1) + j and zero above degree e, by
+// form[0]x + form[1]y + form[2]. Entries are visited from the top so each
+// is read before it is overwritten, and only those up to degree e + 1.
+static void multiply_by_form(std::vector<DoubleDouble>* p, int d, int e, const double form[3])
+{
+    for (int i = e + 1; i >= 0; i--)
+    {
+        for (int j = e + 1 - i; j >= 0; j--)
+        {
+            DoubleDouble c = (*p)[i*(d + 1) + j]*DoubleDouble(form[2]);
+            if (i > 0)
+                c = c + (*p)[(i - 1)*(d + 1) + j]*DoubleDouble(form[0]);
+            if (j > 0)
+                c = c + (*p)[i*(d + 1) + j - 1]*DoubleDouble(form[1]);
+            (*p)[i*(d + 1) + j] = c;
+        }
+    }
+}
+
+// What charting one polynomial needs besides the monomials: the map, the
+// degree bound of the dense arrays, one array per Horner level, reused for
+// every group of monomials at that level, and the powers of the z form.
+struct ChartWork
+{
+    const double (*map)[3];
+    int d;
+    std::vector<DoubleDouble> levels[Polynomial::VAR_Z];
+    // z_powers[k] is the z form to the k-th power, with x^i y^j at
+    // i*(k + 1) - i*(i - 1)/2 + j.
+    std::vector<std::vector<DoubleDouble> > z_powers;
+};
+
+// Adds the monomials in [begin, end), which agree in the variables before
+// var, to result, a dense polynomial of degree *degree, on the chart and
+// with those variables left out, and raises *degree to match. Horner's
+// scheme in var, with coefficients from the next variable down, except
+// that z, the last, takes its powers from the table, and a level whose
+// monomials all lack var passes them straight down.
+static void chart_horner(const std::vector<Polynomial::Monomial>& monomials, unsigned int begin, unsigned int end,
+                         int var, ChartWork* work, std::vector<DoubleDouble>* result, int* degree)
+{
+    int d = work->d;
+    if (var == Polynomial::VAR_Z)
+    {
+        for (unsigned int m = begin; m < end; m++)
+        {
+            int k = monomials[m].exponents[var];
+            const std::vector<DoubleDouble>& power = work->z_powers[k];
+            DoubleDouble coefficient(monomials[m].coefficient);
+            for (int i = 0, c = 0; i <= k; i++)
+            {
+                for (int j = 0; i + j <= k; j++, c++)
+                    (*result)[i*(d + 1) + j] = (*result)[i*(d + 1) + j] + coefficient*power[c];
+            }
+            *degree = std::max(*degree, k);
+        }
+        return;
+    }
+
+    // Monomials are sorted, so equal powers of var are adjacent and come
+    // highest first; if the first is 0, so are the rest.
+    if (monomials[begin].exponents[var] == 0)
+    {
+        chart_horner(monomials, begin, end, var + 1, work, result, degree);
+        return;
+    }
+
+    std::vector<DoubleDouble>& horner = work->levels[var];
+    int horner_degree = 0;
+    int last_exponent = monomials[begin].exponents[var];
+    for (unsigned int i = begin; i < end;)
+    {
+        int exponent = monomials[i].exponents[var];
+        unsigned int group_end = i;
+        while (group_end < end && monomials[group_end].exponents[var] == exponent)
+            group_end++;
+
+        for (int e = exponent; e < last_exponent; e++)
+            multiply_by_form(&horner, d, horner_degree++, work->map[var]);
+        chart_horner(monomials, i, group_end, var + 1, work, &horner, &horner_degree);
+
+        last_exponent = exponent;
+        i = group_end;
+    }
+    for (int e = 0; e < last_exponent; e++)
+        multiply_by_form(&horner, d, horner_degree++, work->map[var]);
+
+    // Moved to the result, leaving the level's array zero for its next use.
+    for (int i = 0; i <= horner_degree; i++)
+    {
+        for (int j = 0; i + j <= horner_degree; j++)
+        {
+            (*result)[i*(d + 1) + j] = (*result)[i*(d + 1) + j] + horner[i*(d + 1) + j];
+            horner[i*(d + 1) + j] = DoubleDouble(0);
+        }
+    }
+    *degree = std::max(*degree, horner_degree);
+}
+
+Polynomial Polynomial::onChart(const double map[3][3]) const
+{
+    Polynomial result;
+    if (monomials.empty())
+        return result;
+
+    ChartWork work;
+    work.map = map;
+    work.d = degree();
+    int d = work.d;
+    for (int v = 0; v < VAR_Z; v++)
+        work.levels[v].assign((d + 1)*(d + 1), DoubleDouble(0));
+
+    // Each power is the last times the form, read off the same dense
+    // layout multiply_by_form works in, up to the highest power of z used.
+    int max_z = 0;
+    for (unsigned int i = 0; i < monomials.size(); i++)
+        max_z = std::max(max_z, monomials[i].exponents[VAR_Z]);
+    std::vector<DoubleDouble> power((d + 1)*(d + 1), DoubleDouble(0));
+    power[0] = DoubleDouble(1);
+    for (int k = 0; k <= max_z; k++)
+    {
+        if (k > 0)
+            multiply_by_form(&power, d, k - 1, map[VAR_Z]);
+        work.z_powers.push_back(std::vector<DoubleDouble>());
+        for (int i = 0; i <= k; i++)
+        {
+            for (int j = 0; i + j <= k; j++)
+                work.z_powers[k].push_back(power[i*(d + 1) + j]);
+        }
+    }
+
+    std::vector<DoubleDouble> dense((d + 1)*(d + 1), DoubleDouble(0));
+    int dense_degree = 0;
+    chart_horner(monomials, 0, monomials.size(), VAR_X, &work, &dense, &dense_degree);
+
+    for (int i = 0; i <= d; i++)
+    {
+        for (int j = 0; i + j <= d; j++)
+        {
+            Monomial m = { { i, j, 0, 0, 0 }, dense[i*(d + 1) + j].hi };
+            result.monomials.push_back(m);
+        }
+    }
+    result.normalize();
+    return result;
+}
+
+double Polynomial::eval(double x, double y, double z, double s, double t) const
+{
+    const double vars[NUM_VARS] = { x, y, z, s, t };
+    double result = 0;
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        double term = monomials[i].coefficient;
+        for (int v = 0; v < NUM_VARS; v++)
+            term *= powi(vars[v], monomials[i].exponents[v]);
+        result += term;
+    }
+    return result;
+}
+
+DoubleDouble Polynomial::evalDoubleDouble(const DoubleDouble& x, const DoubleDouble& y, const DoubleDouble& z,
+                                          const DoubleDouble& s, const DoubleDouble& t) const
+{
+    // powers[v][e] is the e-th power of variable v, computed as needed.
+    // The tables are kept per thread, as this is called for every sample
+    // whose sign is in doubt.
+    static thread_local std::vector<DoubleDouble> powers[NUM_VARS];
+    const DoubleDouble vars[NUM_VARS] = { x, y, z, s, t };
+    for (int v = 0; v < NUM_VARS; v++)
+        powers[v].assign(1, DoubleDouble(1));
+
+    DoubleDouble result(0);
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        DoubleDouble term(monomials[i].coefficient);
+        for (int v = 0; v < NUM_VARS; v++)
+        {
+            while ((int)powers[v].size() <= monomials[i].exponents[v])
+                powers[v].push_back(powers[v].back()*vars[v]);
+            term = term*powers[v][monomials[i].exponents[v]];
+        }
+        result = result + term;
+    }
+    return result;
+}
+
+Polynomial Polynomial::absolute() const
+{
+    Polynomial result = *this;
+    for (unsigned int i = 0; i < result.monomials.size(); i++)
+        result.monomials[i].coefficient = std::abs(result.monomials[i].coefficient);
+    return result;
+}
+
+std::vector<Polynomial> Polynomial::splitST(std::vector<int>* s_exponents, std::vector<int>* t_exponents) const
+{
+    std::vector<Polynomial> parts;
+    s_exponents->clear();
+    t_exponents->clear();
+
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        Monomial m = monomials[i];
+        unsigned int part = 0;
+        while (part < parts.size() && ((*s_exponents)[part] != m.exponents[VAR_S] || (*t_exponents)[part] != m.exponents[VAR_T]))
+            part++;
+
+        if (part == parts.size())
+        {
+            parts.push_back(Polynomial());
+            s_exponents->push_back(m.exponents[VAR_S]);
+            t_exponents->push_back(m.exponents[VAR_T]);
+        }
+
+        m.exponents[VAR_S] = 0;
+        m.exponents[VAR_T] = 0;
+        parts[part].monomials.push_back(m);
+    }
+
+    // Dropping s and t can leave the monomials out of order.
+    for (unsigned int part = 0; part < parts.size(); part++)
+        parts[part].normalize();
+
+    return parts;
+}
+
+Term* Polynomial::toTerm(TermArena* arena) const
+{
+    const Variable::var_type var_types[NUM_VARS] =
+        { Variable::VAR_X, Variable::VAR_Y, Variable::VAR_Z, Variable::VAR_S, Variable::VAR_T };
+
+    Term* sum = 0;
+    for (unsigned int i = 0; i < monomials.size(); i++)
+    {
+        Term* product = 0;
+        for (int v = 0; v < NUM_VARS; v++)
+        {
+            int e = monomials[i].exponents[v];
+            if (e == 0)
+                continue;
+
+            Term* factor = new (arena) Variable(var_types[v]);
+            if (e > 1)
+                factor = new (arena) BinaryOp(BinaryOp::OP_EXP, factor, new (arena) NumericalTerm(e));
+            product = product ? new (arena) BinaryOp(BinaryOp::OP_TIMES, product, factor) : factor;
+        }
+
+        double c = monomials[i].coefficient;
+        if (!product)
+            product = new (arena) NumericalTerm(c);
+        else if (c != 1)
+            product = new (arena) BinaryOp(BinaryOp::OP_TIMES, new (arena) NumericalTerm(c), product);
+
+        sum = sum ? new (arena) BinaryOp(BinaryOp::OP_PLUS, sum, product) : product;
+    }
+
+    return sum ? sum : new (arena) NumericalTerm(0);
+}
+
+// Stands in for a register holding the constant 1, which is never emitted
+// unless something has to be added to it.
+static const int UNIT_REGISTER = -1;
+
+// Register bookkeeping while compiling one polynomial. Each power of a
+// variable is computed once and then kept in a pinned register.
+struct HornerCompiler
+{
+    CompiledTerm* program;
+    std::vector<int> powers[Polynomial::NUM_VARS];
+
+    int power(int var, int exponent)
+    {
+        std::vector<int>& known = powers[var];
+        if ((int)known.size() <= exponent)
+            known.resize(exponent + 1, -1);
+
+        if (known[exponent] < 0)
+        {
+            if (exponent == 1)
+                known[exponent] = program->emitLoadVar(var);
+            else
+                known[exponent] = program->emitPowi(power(var, 1), exponent);
+            program->pinRegister(known[exponent]);
+        }
+        return known[exponent];
+    }
+
+    int materialize(int reg)
+    {
+        return reg == UNIT_REGISTER ? program->emitLoadConst(1) : reg;
+    }
+
+    // Returns reg*var^exponent.
+    int multiplyByPower(int reg, int var, int exponent)
+    {
+        if (exponent == 0)
+            return reg;
+        if (reg == UNIT_REGISTER)
+            return power(var, exponent);
+        return program->emitBinary(CompiledTerm::OP_MUL, reg, power(var, exponent));
+    }
+
+    // Compiles the monomials in [begin, end), which agree in the exponents of
+    // every variable before var, as a Horner scheme in var. The groups of
+    // monomials sharing a power of var are the Horner coefficients, and are
+    // themselves compiled as Horner schemes in the next variable.
+    int compile(const Polynomial::Monomial* begin, const Polynomial::Monomial* end, int var)
+    {
+        if (var == Polynomial::NUM_VARS) // Exactly one monomial is left.
+        {
+            if (begin->coefficient == 1)
+                return UNIT_REGISTER;
+            return program->emitLoadConst(begin->coefficient);
+        }
+
+        int acc = 0;
+        int acc_exponent = 0;
+        for (const Polynomial::Monomial* group = begin; group != end;)
+        {
+            int e = group->exponents[var];
+            const Polynomial::Monomial* group_end = group;
+            while (group_end != end && group_end->exponents[var] == e)
+                group_end++;
+
+            int coefficient = compile(group, group_end, var + 1);
+            if (group == begin)
+                acc = coefficient;
+            else
+            {
+                acc = materialize(multiplyByPower(acc, var, acc_exponent - e));
+                acc = program->emitBinary(CompiledTerm::OP_ADD, acc, materialize(coefficient));
+            }
+
+            acc_exponent = e;
+            group = group_end;
+        }
+
+        return multiplyByPower(acc, var, acc_exponent);
+    }
+};
+
+int Polynomial::compile(CompiledTerm* program) const
+{
+    if (monomials.empty())
+        return program->emitLoadConst(0);
+
+    HornerCompiler compiler;
+    compiler.program = program;
+    const Monomial* begin = monomials.data();
+    return compiler.materialize(compiler.compile(begin, begin + monomials.size(), 0));
+}
@@ -0,0 +1,111 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef POLYNOMIAL_H
+#define POLYNOMIAL_H
+
+#include <vector>
+
+#include "doubledouble.h"
+
+class Term;
+class TermArena;
+class CompiledTerm;
+
+// A polynomial in x, y, z, s, t stored as a sorted list of monomials.
+// Unlike a Term tree this form is canonical: however the user typed it,
+// equal polynomials have equal monomial lists.
+class Polynomial
+{
+public:
+    enum { VAR_X, VAR_Y, VAR_Z, VAR_S, VAR_T, NUM_VARS };
+
+    struct Monomial
+    {
+        int exponents[NUM_VARS];
+        double coefficient;
+
+        int degree() const { return exponents[VAR_X] + exponents[VAR_Y] + exponents[VAR_Z]; }
+    };
+
+    Polynomial() {}
+    explicit Polynomial(double constant);
+    explicit Polynomial(const std::vector<Monomial>& monomials);
+    explicit Polynomial(Term* f);
+    static Polynomial variable(int var);
+
+    Polynomial operator+(const Polynomial& other) const;
+    Polynomial operator-(const Polynomial& other) const;
+    Polynomial operator*(const Polynomial& other) const;
+    Polynomial pow(int exponent) const;
+
+    bool isZero() const { return monomials.empty(); }
+    bool operator==(const Polynomial& other) const;
+    bool operator!=(const Polynomial& other) const { return !(*this == other); }
+    const std::vector<Monomial>& getMonomials() const { return monomials; }
+
+    // Total degree in x, y and z. s and t are parameters and do not count.
+    // The zero polynomial has degree 0.
+    int degree() const;
+    bool isHomogeneous() const;
+    // Highest power of var that occurs.
+    int degreeIn(int var) const;
+    // The coefficient of var^power, as a polynomial in the other variables.
+    Polynomial coefficientOf(int var, int power) const;
+    Polynomial derivative(int var) const;
+
+    // Multiplies each monomial by the power of z that brings it up to degree().
+    Polynomial homogenize() const;
+
+    double eval(double x, double y, double z, double s, double t) const;
+    // As eval, in double-double arithmetic. The coefficients are taken as
+    // exact, so this is accurate to about 32 digits relative to the sum of
+    // the absolute values of the monomials.
+    DoubleDouble evalDoubleDouble(const DoubleDouble& x, const DoubleDouble& y, const DoubleDouble& z,
+                                  const DoubleDouble& s, const DoubleDouble& t) const;
+
+    // The polynomial with the absolute values of these coefficients. It
+    // bounds this one, and the rounding error of evaluating it, at any
+    // point no farther from the origin in each coordinate.
+    Polynomial absolute() const;
+
+    // Substitutes the linear forms map[v][0]x + map[v][1]y + map[v][2]z
+    // for x, y and z (v = 0, 1, 2), in double precision. This is a change of
+    // projective coordinates; s and t are left alone.
+    Polynomial transformed(const double map[3][3]) const;
+    // Sets z to 1, giving this polynomial on the affine chart z = 1.
+    Polynomial dehomogenized() const;
+    // The same as transformed(map).dehomogenized(), for a polynomial without
+    // s or t, but computed in double-double by a nested Horner scheme, so
+    // every coefficient is rounded once from a nearly exact value. Where
+    // the chart is a small piece of the plane the coefficients cancel
+    // heavily, and this keeps the small ones meaningful.
+    Polynomial onChart(const double map[3][3]) const;
+
+    // Writes this polynomial as a sum of s^i t^j f_ij(x, y, z), one entry
+    // of the result per (i, j) that occurs. The exponents go to s_exponents
+    // and t_exponents.
+    std::vector<Polynomial> splitST(std::vector<int>* s_exponents, std::vector<int>* t_exponents) const;
+
+    // Allocates the result in arena.
+    Term* toTerm(TermArena* arena) const;
+
+    // Appends a nested Horner scheme for this polynomial to program,
+    // treating it as a polynomial in x whose coefficients are polynomials
+    // in y, and so on. Returns the register holding the result.
+    int compile(CompiledTerm* program) const;
+
+private:
+    // Sorts monomials, merges equal exponent vectors and drops zeros.
+    void normalize();
+
+    // Sorted lexicographically by exponent vector, highest power of x first.
+    std::vector<Monomial> monomials;
+};
+
+#endif // POLYNOMIAL_H
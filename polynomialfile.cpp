@@ -0,0 +1,292 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "polynomialfile.h"
+
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <string>
+
+#include <QFile>
+
+#include "term.h"
+#include "binaryop.h"
+
+typedef Polynomial::Monomial Monomial;
+
+namespace
+{
+
+// A factor of a summand. Nearly all are single monomials, which are
+// multiplied in place; a Polynomial is only made for parentheses.
+struct Operand
+{
+    Monomial monomial;
+    Polynomial polynomial;
+    bool is_monomial;
+};
+
+Monomial constant_monomial(double c)
+{
+    Monomial m = { { 0, 0, 0, 0, 0 }, c };
+    return m;
+}
+
+// The same grammar as the Parser of term.cpp: +, - and * associate to the
+// left, ^ to the right, juxtaposition is multiplication, and unary minus
+// binds tighter than anything, so -x^2 is (-x)^2.
+struct StreamParser
+{
+    const char* begin;
+    const char* pos;
+    const char* end;
+    const ParseProgress& progress;
+    long long next_report;
+    int depth; // Of parentheses and exponents, to keep the stack bounded.
+
+    static const int MAX_DEPTH = 10000;
+    static const long long REPORT_INTERVAL = 1 << 20;
+
+    // Advances to the next non-space character. Returns false at the end.
+    bool skipSpace()
+    {
+        while (pos != end && isspace((unsigned char)*pos))
+            pos++;
+        return pos != end;
+    }
+
+    void enter()
+    {
+        if (++depth > MAX_DEPTH)
+            throw BadTermException("Expression nested too deeply.");
+    }
+
+    void report()
+    {
+        if (!progress || pos - begin < next_report)
+            return;
+        if (!progress(pos - begin, end - begin))
+            throw LoadCancelledException();
+        next_report = (pos - begin) + REPORT_INTERVAL;
+    }
+
+    // As Parser::parseNumber.
+    double parseNumber()
+    {
+        const char* start = pos;
+        double num_so_far = 0;
+        bool exact = true;
+        for (; pos != end && '0' <= *pos && *pos <= '9'; pos++)
+        {
+            num_so_far = num_so_far*10 + (*pos - '0');
+            if (num_so_far >= 9007199254740992.0) // 2^53
+                exact = false;
+        }
+        if (exact)
+            return num_so_far;
+        return strtod(std::string(start, pos).c_str(), 0);
+    }
+
+    void parseAtomic(Operand* a)
+    {
+        if (!skipSpace())
+            throw BadTermException("Expected Term.");
+
+        char c = *pos;
+        a->is_monomial = true;
+        a->monomial = constant_monomial(1);
+
+        if (c == '-')
+        {
+            pos++;
+            enter();
+            parseAtomic(a);
+            depth--;
+            if (a->is_monomial)
+                a->monomial.coefficient = -a->monomial.coefficient;
+            else
+                a->polynomial = Polynomial(-1.0)*a->polynomial;
+            return;
+        }
+
+        if ('0' <= c && c <= '9')
+        {
+            a->monomial.coefficient = parseNumber();
+            return;
+        }
+
+        const char vars[Polynomial::NUM_VARS] = { 'x', 'y', 'z', 's', 't' };
+        for (int v = 0; v < Polynomial::NUM_VARS; v++)
+        {
+            if (c == vars[v])
+            {
+                pos++;
+                a->monomial.exponents[v] = 1;
+                return;
+            }
+        }
+
+        if (c == '(')
+        {
+            pos++;
+            enter();
+            std::vector<Monomial> inner;
+            parseSum(&inner);
+            depth--;
+            if (!skipSpace() || *pos != ')')
+                throw BadTermException("Unclosed parenthesis.");
+            pos++;
+
+            a->polynomial = Polynomial(inner);
+            const std::vector<Monomial>& monomials = a->polynomial.getMonomials();
+            if (monomials.size() <= 1)
+                a->monomial = monomials.empty() ? constant_monomial(0) : monomials[0];
+            else
+                a->is_monomial = false;
+            return;
+        }
+
+        throw BadTermException("Unexpected character.");
+    }
+
+    // An atom, raised to the power after it if there is one.
+    void parsePower(Operand* a)
+    {
+        parseAtomic(a);
+        if (!skipSpace() || *pos != '^')
+            return;
+        pos++;
+
+        enter();
+        Operand exponent;
+        parsePower(&exponent);
+        depth--;
+
+        if (!exponent.is_monomial || exponent.monomial.degree() != 0
+                || exponent.monomial.exponents[Polynomial::VAR_S] != 0
+                || exponent.monomial.exponents[Polynomial::VAR_T] != 0)
+            throw BadTermException("Variables not allowed in exponents.");
+        double value = exponent.monomial.coefficient;
+        if (value < 0)
+            throw BadTermException("Negative exponents not allowed.");
+        if (value > INT_MAX)
+            throw BadTermException("Exponent too large.");
+        int n = (int)value;
+
+        if (!a->is_monomial)
+        {
+            a->polynomial = a->polynomial.pow(n);
+            return;
+        }
+        for (int v = 0; v < Polynomial::NUM_VARS; v++)
+        {
+            if (n != 0 && a->monomial.exponents[v] > INT_MAX/n)
+                throw BadTermException("Exponent too large.");
+            a->monomial.exponents[v] *= n;
+        }
+        a->monomial.coefficient = powi(a->monomial.coefficient, n);
+    }
+
+    // Multiplies out one summand and appends its monomials to out, times sign.
+    void addProduct(double sign, std::vector<Monomial>* out)
+    {
+        Monomial product = constant_monomial(sign);
+        Polynomial rest(1.0);
+        bool has_rest = false;
+
+        Operand a;
+        parsePower(&a);
+        while (true)
+        {
+            if (a.is_monomial)
+            {
+                product.coefficient *= a.monomial.coefficient;
+                for (int v = 0; v < Polynomial::NUM_VARS; v++)
+                    product.exponents[v] += a.monomial.exponents[v];
+            }
+            else
+            {
+                rest = has_rest ? rest*a.polynomial : a.polynomial;
+                has_rest = true;
+            }
+
+            if (!skipSpace())
+                break;
+            if (*pos == '*')
+                pos++;
+            else if (!('0' <= *pos && *pos <= '9') && *pos != '(' && *pos != 'x' && *pos != 'y'
+                     && *pos != 'z' && *pos != 's' && *pos != 't')
+                break;
+            parsePower(&a);
+        }
+
+        if (!has_rest)
+        {
+            out->push_back(product);
+            return;
+        }
+        const std::vector<Monomial>& monomials = rest.getMonomials();
+        for (unsigned int i = 0; i < monomials.size(); i++)
+        {
+            Monomial m = monomials[i];
+            m.coefficient *= product.coefficient;
+            for (int v = 0; v < Polynomial::NUM_VARS; v++)
+                m.exponents[v] += product.exponents[v];
+            out->push_back(m);
+        }
+    }
+
+    // Appends the monomials of a sum of products to out, unsorted. Stops
+    // at a closing parenthesis or the end of the input.
+    void parseSum(std::vector<Monomial>* out)
+    {
+        addProduct(1, out);
+        while (skipSpace() && *pos != ')')
+        {
+            if (*pos != '+' && *pos != '-')
+                throw BadTermException("Expected operator.");
+            double sign = *pos == '+' ? 1 : -1;
+            pos++;
+            addProduct(sign, out);
+            report();
+        }
+    }
+};
+
+}
+
+Polynomial parsePolynomial(const char* begin, const char* end, const ParseProgress& progress)
+{
+    StreamParser parser = { begin, begin, end, progress, StreamParser::REPORT_INTERVAL, 0 };
+    std::vector<Monomial> monomials;
+    parser.parseSum(&monomials);
+
+    // parseSum only stops early at a closing parenthesis.
+    if (parser.skipSpace())
+        throw BadTermException("Too many closing parentheses.");
+
+    if (progress && !progress(end - begin, end - begin))
+        throw LoadCancelledException();
+    return Polynomial(monomials);
+}
+
+Polynomial loadPolynomialFile(const QString& path, const ParseProgress& progress)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        throw BadTermException("Could not open file.");
+    if (file.size() == 0)
+        throw BadTermException("Expected Term.");
+
+    // The mapping goes away with file.
+    const char* data = (const char*)file.map(0, file.size());
+    if (!data)
+        throw BadTermException("Could not map file.");
+    return parsePolynomial(data, data + file.size(), progress);
+}
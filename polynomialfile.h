@@ -0,0 +1,37 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef POLYNOMIALFILE_H
+#define POLYNOMIALFILE_H
+
+#include <functional>
+
+#include <QString>
+
+#include "polynomial.h"
+
+// Called every so often with how many bytes have been parsed out of how
+// many. Returning false stops the parse with a LoadCancelledException.
+typedef std::function<bool(long long done, long long total)> ParseProgress;
+
+class LoadCancelledException
+{
+};
+
+// Parses [begin, end) in the syntax of Term::parseTerm, straight into a
+// Polynomial. Each summand is multiplied out as it is read and appended to
+// one list of monomials, which is sorted once at the end, so no Term tree
+// is built and memory is proportional to the number of monomials. Throws
+// BadTermException on a syntax error.
+Polynomial parsePolynomial(const char* begin, const char* end, const ParseProgress& progress = ParseProgress());
+
+// Memory-maps the file at path and parses it with parsePolynomial. The
+// text is read in place; the file is never copied into a string.
+Polynomial loadPolynomialFile(const QString& path, const ParseProgress& progress = ParseProgress());
+
+#endif // POLYNOMIALFILE_H
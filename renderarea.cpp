@@ -13,6 +13,7 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <algorithm>
 
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
@@ -23,6 +24,20 @@
 #include <QDir>
 
 #include <QTime>
+#include <QElapsedTimer>
+
+#include "allocationcounter.h"
+
+// The number after name in arguments, or default_value if it isn't there.
+static double double_argument(const QStringList& arguments, const char* name, double default_value)
+{
+    int i = arguments.indexOf(name);
+    if (i < 0 || i + 1 >= arguments.size())
+        return default_value;
+    bool ok;
+    double value = arguments[i + 1].toDouble(&ok);
+    return ok ? value : default_value;
+}
 
 RenderArea::RenderArea(QWidget* parent) : QOpenGLWidget(parent)
 {
@@ -33,24 +48,101 @@ RenderArea::RenderArea(QWidget* parent) : QOpenGLWidget(parent)
     last_frame_time = QTime::currentTime();
 
     startOfSecond = QTime::currentTime();
+
+    QStringList arguments = QCoreApplication::arguments();
+
+    // Run with --pencil n to draw n members of each pencil of curves at once.
+    int pencil_arg = arguments.indexOf("--pencil");
+    if (pencil_arg >= 0 && pencil_arg + 1 < arguments.size())
+        pencil_size = std::max(1, std::min((int)MAX_PENCIL_SIZE, arguments[pencil_arg + 1].toInt()));
+
+    // The extraction settings can be overridden with --coarse-cell-px,
+    // --min-cell-px, --chord-error-px and --min-relative-gradient, each
+    // followed by a number, and --refine-crossings.
+    ExtractionSettings& settings = extraction_settings;
+    settings.coarse_cell_pixels = double_argument(arguments, "--coarse-cell-px", settings.coarse_cell_pixels);
+    settings.min_cell_pixels = double_argument(arguments, "--min-cell-px", settings.min_cell_pixels);
+    settings.max_chord_error_pixels = double_argument(arguments, "--chord-error-px", settings.max_chord_error_pixels);
+    settings.min_relative_gradient = double_argument(arguments, "--min-relative-gradient", settings.min_relative_gradient);
+    settings.refine_crossings = arguments.contains("--refine-crossings");
+    // Run with --newton-steps n to project vertices onto the curves, and
+    // with --measure-vertex-error to report how far off they are.
+    settings.newton_steps = std::max(0, (int)double_argument(arguments, "--newton-steps", settings.newton_steps));
+    settings.measure_vertex_error = arguments.contains("--measure-vertex-error");
+
+    // Run with --threads n to extract curves on at most n threads.
+    setMaxThreads((int)double_argument(arguments, "--threads", 0));
+
+    // Run with --frame-stats to print, each second, what the last frame's
+    // extraction and upload did.
+    print_frame_stats = arguments.contains("--frame-stats");
 }
 
 RenderArea::~RenderArea()
 {
     while (functions.size() > 0)
+        deleteFunction(functions.size() - 1);
+}
+
+void RenderArea::setFunction(int index, const SharedFunction& f)
+{
+    functions[index] = f;
+    const std::vector<Factor> no_factors;
+    const std::vector<Factor>& factors = f ? f->getFactors() : no_factors;
+
+    // Factors the edit left alone keep their curves. The others are new,
+    // and start with empty sample caches.
+    std::vector<FactorCurve*> old_curves = factor_curves[index];
+    std::vector<FactorCurve*> curves;
+    for (unsigned int i = 0; i < factors.size(); i++)
     {
-        delete functions[functions.size() - 1];
-        functions.erase(functions.end() - 1);
-        function_colors.erase(function_colors.end() - 1);
+        FactorCurve* curve = 0;
+        for (unsigned int j = 0; j < old_curves.size() && !curve; j++)
+        {
+            if (old_curves[j] && old_curves[j]->polynomial == factors[i].polynomial)
+            {
+                curve = old_curves[j];
+                old_curves[j] = 0;
+            }
+        }
+
+        if (!curve)
+        {
+            curve = new FactorCurve();
+            curve->polynomial = factors[i].polynomial;
+            curve->decomposition = new STDecomposition(factors[i].polynomial);
+        }
+        curves.push_back(curve);
     }
+
+    for (unsigned int j = 0; j < old_curves.size(); j++)
+    {
+        if (old_curves[j])
+        {
+            delete old_curves[j]->decomposition;
+            delete old_curves[j];
+        }
+    }
+    factor_curves[index] = curves;
+}
+
+void RenderArea::setMaxThreads(int n)
+{
+    thread_pool.reset(new ThreadPool(n));
+    scheduler.reset(new WorkStealingScheduler<ExtractionTask>(thread_pool.get()));
 }
 
-void RenderArea::setFunction(int index, Term* f)
+long RenderArea::stealsLastFrame() const
 {
-    if (functions[index])
-        delete functions[index];
+    long steals = 0;
+    for (unsigned int i = 0; i < worker_stats_last_frame.size(); i++)
+        steals += worker_stats_last_frame[i].steals;
+    return steals;
+}
 
-    functions[index] = f;
+double RenderArea::meanVertexErrorLastFrame() const
+{
+    return measured_vertices_last_frame > 0 ? vertex_error_sum_last_frame/measured_vertices_last_frame : 0;
 }
 
 void RenderArea::setFunctionColor(int index, QVector3D color)
@@ -60,25 +152,31 @@ void RenderArea::setFunctionColor(int index, QVector3D color)
 
 void RenderArea::addFunction(QVector3D color)
 {
-    functions.push_back(0);
+    functions.push_back(SharedFunction());
+    factor_curves.push_back(std::vector<FactorCurve*>());
     function_colors.push_back(color);
 }
 
 void RenderArea::deleteFunction(int index)
 {
-    delete functions[index];
+    for (unsigned int i = 0; i < factor_curves[index].size(); i++)
+    {
+        delete factor_curves[index][i]->decomposition;
+        delete factor_curves[index][i];
+    }
     functions.erase(functions.begin() + index);
+    factor_curves.erase(factor_curves.begin() + index);
     function_colors.erase(function_colors.begin() + index);
 }
 
-void RenderArea::setYScale(float newScale)
+void RenderArea::setYScale(double newScale)
 {
-    if (newScale > 40.0f)
-        newScale = 40.0f;
-    if (newScale < 0.0001f)
-        newScale = 0.0001f;
+    if (newScale > 40.0)
+        newScale = 40.0;
+    if (newScale < 1e-12)
+        newScale = 1e-12;
     vertical_scale = newScale;
-    horizontal_scale = vertical_scale*this->width() / float(this->height());
+    horizontal_scale = vertical_scale*this->width() / double(this->height());
 }
 
 void RenderArea::snapToXYPlane()
@@ -89,19 +187,21 @@ void RenderArea::snapToXYPlane()
 
 void RenderArea::snapToXZPlane()
 {
-    view_rotation = QMatrix4x4(1, 0, 0, 0,
-                               0, 0, 1, 0,
-                               0, -1, 0, 0,
-                               0, 0, 0, 1);
+    const double values[16] = { 1, 0, 0, 0,
+                                0, 0, 1, 0,
+                                0, -1, 0, 0,
+                                0, 0, 0, 1 };
+    view_rotation = ViewMatrix(values);
     update();
 }
 
 void RenderArea::snapToYZPlane()
 {
-    view_rotation = QMatrix4x4(0, 0, -1, 0,
-                               0, 1, 0, 0,
-                               1, 0, 0, 0,
-                               0, 0, 0, 1);
+    const double values[16] = { 0, 0, -1, 0,
+                                0, 1, 0, 0,
+                                1, 0, 0, 0,
+                                0, 0, 0, 1 };
+    view_rotation = ViewMatrix(values);
     update();
 }
 
@@ -220,6 +320,14 @@ void RenderArea::initializeGL()
 
     f->glGenBuffers(1, &vbuffer_handle);
 
+    // Curves are streamed through these, a chunk at a time.
+    f->glGenBuffers(NUM_UPLOAD_BUFFERS, upload_buffers);
+    for (int i = 0; i < NUM_UPLOAD_BUFFERS; i++)
+    {
+        f->glBindBuffer(GL_ARRAY_BUFFER, upload_buffers[i]);
+        f->glBufferData(GL_ARRAY_BUFFER, sizeof(float)*UPLOAD_CHUNK_VERTICES*3, 0, GL_STREAM_DRAW);
+    }
+
     vertexColor_handle = f->glGetUniformLocation(programid, "vertexColor");
 
     if (vertexColor_handle == -1)
@@ -237,141 +345,830 @@ void RenderArea::resizeGL(int w, int h)
     projection.setToIdentity();
     projection.perspective(45.0f, w / float(h), 0.01f, 100.0f);
 
-    horizontal_scale = vertical_scale*w / float(h);
+    horizontal_scale = vertical_scale*w / double(h);
 }
 
-// Build up the curve using a recursive marching squares algorithm.
-// That is, we sample values of the relevant function on a square grid.
-// Where there are sign changes, we either recurse to use a higher resolution
-// grid, or add vertices between the sample points where signs changed.
-void RenderArea::addVerticesPatch(int index, int res, double x_min, double x_max, double y_min, double y_max, std::vector<QVector3D>* active_vertices,
-                                  int recursion_depth)
+// Marching squares on a res by res grid of cells over the rectangle, given
+// the function's values at the grid points, column by column. Where the sign
+// changes along an edge of a cell, a vertex is placed on that edge by linear
+// interpolation.
+void RenderArea::addGridVertices(const double* vals, int res, int i_begin, int i_end, int j_begin, int j_end,
+                                 double x_min, double x_max, double y_min, double y_max,
+                                 std::vector<QVector3D>* active_vertices)
 {
-    const int recursion_res = 2;
-    const int MAX_RECURSION_DEPTH = 1;
-
     double xstep = (x_max - x_min)/res;
     double ystep = (y_max - y_min)/res;
 
-    // Compute function values at grid points.
-    double* vals = new double[(res+1)*(res+1)];
-
-    for (int i = 0; i <= res; i++)
+    for (int i = i_begin; i < i_end; i++)
     {
-        for (int j = 0; j <= res; j++)
+        for (int j = j_begin; j < j_end; j++)
         {
             double x = x_min + xstep*i;
             double y = y_min + ystep*j;
 
-            // Testing.
-            vals[(res + 1)*i + j] = functions[index]->eval(view_rotation*QVector4D(x,y,1,1), s, t);
+            double val_ll = vals[(res + 1)*i + j];
+            double val_lr = vals[(res + 1)*(i + 1) + j];
+            double val_ul = vals[(res + 1)*i + j + 1];
+            double val_ur = vals[(res + 1)*(i + 1) + j + 1];
+
+            int times_flopped = 0;
+
+            if (val_ll*val_lr <= 0)
+            {
+                active_vertices->push_back(QVector3D((-val_ll * xstep)/(val_lr - val_ll) + x, y, 0));
+                times_flopped++;
+            }
+            if (val_ul*val_ur <= 0)
+            {
+                active_vertices->push_back(QVector3D((-val_ul * xstep)/(val_ur - val_ul) + x, y + ystep, 0));
+                times_flopped++;
+            }
+            if (val_ll*val_ul <= 0)
+            {
+                active_vertices->push_back(QVector3D(x, (-val_ll * ystep)/(val_ul - val_ll) + y, 0));
+                times_flopped++;
+            }
+            if (val_lr*val_ur <= 0)
+            {
+                active_vertices->push_back(QVector3D(x + xstep, (-val_lr * ystep)/(val_ur - val_lr) + y, 0));
+                times_flopped++;
+            }
+
+            // We want to leave an even number of vertices for this square;
+            // adjacent vertices in the list are paired into lines.
+            if (times_flopped == 1 || times_flopped == 3)
+                active_vertices->pop_back();
         }
     }
+}
 
-    for (int i = 0; i < res; i++)
+// Forgets the cached samples of curve if the view has moved since they
+// were taken, and moves its decomposition to the new chart.
+void RenderArea::updateSampleCache(FactorCurve* curve)
+{
+    SampleCache* cache = &curve->cache;
+    if (cache->view_rotation == view_rotation && cache->horizontal_scale == horizontal_scale
+            && cache->vertical_scale == vertical_scale && cache->root)
+        return;
+
+    // The screen point (x, y) is view_rotation*(x, y, 1, 1). As a map of
+    // (x, y, 1), that is the first two columns and the sum of the last two.
+    // The chart measures x and y in units of vertical_scale, so the screen
+    // is about [-1, 1] on it at any zoom, and its origin is the view center:
+    // the terms are re-expanded about the center of whatever is on screen.
+    const double* m = view_rotation.constData();
+    const double chart[3][3] = {
+        { m[0]*vertical_scale, m[4]*vertical_scale, m[8] + m[12] },
+        { m[1]*vertical_scale, m[5]*vertical_scale, m[9] + m[13] },
+        { m[2]*vertical_scale, m[6]*vertical_scale, m[10] + m[14] }
+    };
+    curve->decomposition->setChart(chart);
+
+    cache->view_rotation = view_rotation;
+    cache->horizontal_scale = horizontal_scale;
+    cache->vertical_scale = vertical_scale;
+    cache->root.reset(new QuadtreeNode());
+    cache->edges.clear();
+}
+
+// Bounds of each term of the decomposition of curve over the rectangle of
+// the chart that node covers.
+const std::vector<Interval>& RenderArea::nodeBounds(FactorCurve* curve, QuadtreeNode* node,
+                                                    double x_min, double x_max, double y_min, double y_max)
+{
+    std::vector<Interval>& bounds = node->bounds;
+    STDecomposition* decomposition = curve->decomposition;
+    if (!bounds.empty() || decomposition->numTerms() == 0)
+        return bounds;
+
+    // The charted terms were rounded, so their bounds are widened by the
+    // error of charting to stay bounds for the exact f_k.
+    double max_abs_x = std::max(std::abs(x_min), std::abs(x_max));
+    double max_abs_y = std::max(std::abs(y_min), std::abs(y_max));
+    for (int k = 0; k < decomposition->numTerms(); k++)
     {
-        for (int j = 0; j < res; j++)
+        double error = decomposition->errorBound(k, max_abs_x, max_abs_y);
+        bounds.push_back(decomposition->boundTerm(k, Interval(x_min, x_max), Interval(y_min, y_max))
+                         + Interval(-error, error));
+    }
+    return bounds;
+}
+
+// Where an edge of a node lies on the grid of its level: vertical edges by
+// the column of nodes to their right and the row they span, horizontal
+// ones by the column they span and the row above them.
+static quint64 edge_key(int level, bool vertical, int i, int j)
+{
+    return (quint64)level << 58 | (quint64)vertical << 57 | (quint64)i << 28 | (quint64)j;
+}
+
+// Values of each term of the decomposition of curve on the LEAF_RES by
+// LEAF_RES grid of cells over the node of task, in the layout of
+// evalTermsGrid. Bounds on their errors go to the error_bounds of node.
+// No point is evaluated twice: every other point of the grid is one of the
+// parent's, if it was sampled, and is copied from there, and the edges of
+// the grid are shared with the neighbours on the same level through the
+// curve's EdgeSampleStore. The rest is evaluated in a few strided grids.
+// The numbers of values computed and copied are added to samples_taken
+// and samples_reused.
+const std::vector<double>& RenderArea::nodeSamples(FactorCurve* curve, const ExtractionTask& task,
+                                                   long* samples_taken, long* samples_reused)
+{
+    QuadtreeNode* node = task.node;
+    std::vector<double>& samples = node->samples;
+    std::vector<double>& errors = node->error_bounds;
+    std::vector<double>& own_errors = node->own_error_bounds;
+    const STDecomposition* decomposition = curve->decomposition;
+    const int num_terms = decomposition->numTerms();
+    const int stride = LEAF_RES + 1;
+    const int n = stride*stride;
+    const int half = LEAF_RES/2;
+    if (!samples.empty() || num_terms == 0)
+        return samples;
+
+    samples.resize(num_terms*n);
+    own_errors.assign(num_terms, 0.0);
+    bool known[(LEAF_RES + 1)*(LEAF_RES + 1)] = {};
+    const double xstep = (task.x_max - task.x_min)/LEAF_RES;
+    const double ystep = (task.y_max - task.y_min)/LEAF_RES;
+
+    // Evaluates the points (i_begin + a*di, j_begin + b*dj) of the grid for
+    // a < ni and b < nj. The decomposition is on the screen's chart
+    // already, so they go in as they are.
+    static thread_local std::vector<double> values, value_errors;
+    value_errors.resize(num_terms);
+    auto evaluate = [&](int i_begin, int di, int ni, int j_begin, int dj, int nj)
+    {
+        if (ni <= 0 || nj <= 0)
+            return;
+        values.resize(num_terms*ni*nj);
+        decomposition->evalTermsGrid(task.x_min + xstep*i_begin, xstep*di, ni,
+                                     task.y_min + ystep*j_begin, ystep*dj, nj,
+                                     values.data(), value_errors.data());
+        for (int k = 0; k < num_terms; k++)
         {
-            double x = x_min + xstep*i;
-            double y = y_min + ystep*j;
+            own_errors[k] = std::max(own_errors[k], value_errors[k]);
+            for (int a = 0; a < ni; a++)
+                for (int b = 0; b < nj; b++)
+                    samples[k*n + (i_begin + a*di)*stride + j_begin + b*dj] = values[(k*ni + a)*nj + b];
+        }
+        for (int a = 0; a < ni; a++)
+            for (int b = 0; b < nj; b++)
+                known[(i_begin + a*di)*stride + j_begin + b*dj] = true;
+        *samples_taken += num_terms*ni*nj;
+    };
+
+    // The points with even indices are the parent's grid over this quarter.
+    const QuadtreeNode* parent = task.parent;
+    bool inherited = parent && !parent->samples.empty();
+    if (inherited)
+    {
+        int i0 = (task.ix & 1)*half;
+        int j0 = (task.iy & 1)*half;
+        for (int k = 0; k < num_terms; k++)
+        {
+            own_errors[k] = parent->error_bounds[k];
+            for (int a = 0; a <= half; a++)
+                for (int b = 0; b <= half; b++)
+                    samples[k*n + 2*a*stride + 2*b] = parent->samples[k*n + (i0 + a)*stride + j0 + b];
+        }
+        for (int a = 0; a <= half; a++)
+            for (int b = 0; b <= half; b++)
+                known[2*a*stride + 2*b] = true;
+        *samples_reused += num_terms*(half + 1)*(half + 1);
+    }
 
-            double val_ll = vals[(res + 1)*i + j];
-            double val_lr = vals[(res + 1)*(i + 1) + j];
-            double val_ul = vals[(res + 1)*i + j + 1];
-            double val_ur = vals[(res + 1)*(i + 1) + j + 1];
+    // The left, right, bottom and top edges. Each is stored as the values
+    // of each term along it, then the terms' error bounds. found_errors
+    // keeps the bounds of each edge found, and corner_source which found
+    // edge each corner of the grid, 2*(i side) + j side, was copied from,
+    // if any: an edge stored below has its ends' bounds as well as this
+    // node's.
+    static thread_local std::vector<double> edge, edge_errors, found_errors;
+    edge.resize(num_terms*(stride + 1));
+    edge_errors.assign(num_terms, 0.0);
+    found_errors.resize(4*num_terms);
+    int corner_source[4] = { -1, -1, -1, -1 };
+    quint64 keys[4];
+    bool found[4];
+    for (int e = 0; e < 4; e++)
+    {
+        bool vertical = e < 2;
+        int side = e & 1;
+        keys[e] = vertical ? edge_key(task.level, true, task.ix + side, task.iy)
+                           : edge_key(task.level, false, task.ix, task.iy + side);
+        found[e] = curve->cache.edges.find(keys[e], edge.data());
+        if (!found[e])
+            continue;
+
+        for (int t = 0; t < stride; t++)
+        {
+            int p = vertical ? side*LEAF_RES*stride + t : t*stride + side*LEAF_RES;
+            if (known[p])
+                continue;
+            for (int k = 0; k < num_terms; k++)
+                samples[k*n + p] = edge[k*stride + t];
+            known[p] = true;
+            *samples_reused += num_terms;
+            if (t == 0 || t == LEAF_RES)
+            {
+                int end = t/LEAF_RES;
+                corner_source[vertical ? 2*side + end : 2*end + side] = e;
+            }
+        }
+        for (int k = 0; k < num_terms; k++)
+        {
+            found_errors[e*num_terms + k] = edge[num_terms*stride + k];
+            edge_errors[k] = std::max(edge_errors[k], edge[num_terms*stride + k]);
+        }
+    }
+
+    // What is left, in grids of whole columns, since evalTermsGrid pays
+    // for each column it starts. Columns on a stored edge are skipped, and
+    // the others are cut short at stored edges.
+    int i_begin = found[0] ? 1 : 0;
+    int i_end = found[1] ? LEAF_RES : stride;
+    int j_begin = found[2] ? 1 : 0;
+    int j_end = found[3] ? LEAF_RES : stride;
+    if (inherited)
+    {
+        // The odd columns, then the odd points of the even ones.
+        evaluate(1, 2, half, j_begin, 1, j_end - j_begin);
+        i_begin += i_begin & 1;
+        evaluate(i_begin, 2, (i_end - 1 - i_begin)/2 + 1, 1, 2, half);
+    }
+    else
+    {
+        evaluate(i_begin, 1, i_end - i_begin, j_begin, 1, j_end - j_begin);
+    }
+
+    for (int e = 0; e < 4; e++)
+    {
+        if (found[e])
+            continue;
+        bool vertical = e < 2;
+        int side = e & 1;
+        for (int t = 0; t < stride; t++)
+        {
+            int p = vertical ? side*LEAF_RES*stride + t : t*stride + side*LEAF_RES;
+            for (int k = 0; k < num_terms; k++)
+                edge[k*stride + t] = samples[k*n + p];
+        }
+        for (int k = 0; k < num_terms; k++)
+            edge[num_terms*stride + k] = own_errors[k];
+        for (int end = 0; end < 2; end++)
+        {
+            int source = corner_source[vertical ? 2*side + end : 2*end + side];
+            if (source < 0)
+                continue;
+            for (int k = 0; k < num_terms; k++)
+                edge[num_terms*stride + k] = std::max(edge[num_terms*stride + k], found_errors[source*num_terms + k]);
+        }
+        curve->cache.edges.insert(keys[e], edge.data(), edge.size());
+    }
+
+    errors.resize(num_terms);
+    for (int k = 0; k < num_terms; k++)
+        errors[k] = std::max(own_errors[k], edge_errors[k]);
+    return samples;
+}
+
+// The largest change of f across an edge of cell (i, j) of a res by res
+// grid of values: about |grad f| times the size of the cell.
+static double cell_gradient(const double* vals, int res, int i, int j)
+{
+    double ll = vals[(res + 1)*i + j];
+    double lr = vals[(res + 1)*(i + 1) + j];
+    double ul = vals[(res + 1)*i + j + 1];
+    double ur = vals[(res + 1)*(i + 1) + j + 1];
+    return std::max(std::max(std::abs(lr - ll), std::abs(ur - ul)), std::max(std::abs(ul - ll), std::abs(ur - lr)));
+}
+
+// Whether any of the cells [i_begin, i_end) by [j_begin, j_end) of a res by
+// res grid of values meets a refinement criterion of settings. Cells are
+// cell_pixels wide, and max_gradient is the largest cell_gradient on the
+// grid.
+static bool cells_need_refinement(const double* vals, int res, int i_begin, int i_end, int j_begin, int j_end,
+                                  double cell_pixels, double max_gradient,
+                                  const RenderArea::ExtractionSettings& settings)
+{
+    const int stride = res + 1;
+    for (int i = i_begin; i < i_end; i++)
+    {
+        for (int j = j_begin; j < j_end; j++)
+        {
+            double ll = vals[stride*i + j];
+            double lr = vals[stride*(i + 1) + j];
+            double ul = vals[stride*i + j + 1];
+            double ur = vals[stride*(i + 1) + j + 1];
+            bool crossed = ll*lr <= 0 || ul*ur <= 0 || ll*ul <= 0 || lr*ur <= 0;
+            double gradient = cell_gradient(vals, res, i, j);
+
+            if (crossed && settings.refine_crossings)
+                return true;
 
-            // If there are sign changes and we are below the maximum recursion depth,
-            // recurse to get a higher quality approximation.
-            if (recursion_depth < MAX_RECURSION_DEPTH)
+            if (crossed && settings.max_chord_error_pixels > 0)
             {
-                if (val_ll*val_lr < 0 || val_ul*val_ur < 0 || val_ll*val_ul < 0 || val_lr*val_ur < 0)
-                {
-                    addVerticesPatch(index, recursion_res, x, x + xstep, y, y + ystep, active_vertices, recursion_depth + 1);
-                }
+                // Marching squares interpolates linearly along each edge,
+                // which is off by up to an eighth of the second difference
+                // there; the zero moves by that much over the gradient.
+                int i0 = std::min(i, res - 2);
+                int j0 = std::min(j, res - 2);
+                double second = std::abs(ll - lr - ul + ur);
+                second = std::max(second, std::abs(vals[stride*i0 + j] - 2*vals[stride*(i0 + 1) + j] + vals[stride*(i0 + 2) + j]));
+                second = std::max(second, std::abs(vals[stride*i + j0] - 2*vals[stride*i + j0 + 1] + vals[stride*i + j0 + 2]));
+                if (second*cell_pixels > 8*settings.max_chord_error_pixels*gradient)
+                    return true;
             }
-            else
+
+            double nearest = std::min(std::min(std::abs(ll), std::abs(lr)), std::min(std::abs(ul), std::abs(ur)));
+            if (nearest <= max_gradient && gradient < settings.min_relative_gradient*max_gradient)
+                return true;
+        }
+    }
+    return false;
+}
+
+// Walks the quadtree of curve from node, which covers the rectangle of the
+// chart, down to TILE_LEVEL, and adds a tile for each node there that some
+// member of the pencil may pass through. A node that is sampled is never
+// split between tiles, so tiles stop above TILE_LEVEL where cells reach
+// the coarse grid. The members have term weights w, num_members sets one
+// after another.
+void RenderArea::collectTiles(FactorCurve* curve, QuadtreeNode* node, const double* w, int num_members,
+                              int level, int ix, int iy, double x_min, double x_max, double y_min, double y_max,
+                              double pixels_per_unit)
+{
+    // Members that miss part of a tile are culled there, one by one.
+    const std::vector<Interval>& bounds = nodeBounds(curve, node, x_min, x_max, y_min, y_max);
+    bool missed = true;
+    for (int member = 0; member < num_members && missed; member++)
+    {
+        Interval bound(0);
+        for (unsigned int k = 0; k < bounds.size(); k++)
+            bound = bound + bounds[k]*w[member*bounds.size() + k];
+        missed = !bound.containsZero();
+    }
+    if (missed)
+    {
+        culled_cells_this_frame += num_members;
+        return;
+    }
+
+    double cell_pixels = (y_max - y_min)*pixels_per_unit/LEAF_RES;
+    if (level == TILE_LEVEL || cell_pixels <= extraction_settings.coarse_cell_pixels || level == MAX_QUADTREE_DEPTH)
+    {
+        ExtractionTile tile = { curve, node, w, num_members, level, ix, iy, x_min, x_max, y_min, y_max, pixels_per_unit };
+        extraction_tiles.push_back(tile);
+        return;
+    }
+
+    if (!node->children)
+        node->children.reset(new QuadtreeNode[4]);
+    const double xs[3] = { x_min, (x_min + x_max)/2, x_max };
+    const double ys[3] = { y_min, (y_min + y_max)/2, y_max };
+    for (int q = 0; q < 4; q++)
+        collectTiles(curve, &node->children[q], w, num_members, level + 1, 2*ix + (q & 1), 2*iy + (q >> 1),
+                     xs[q & 1], xs[(q & 1) + 1], ys[q >> 1], ys[(q >> 1) + 1], pixels_per_unit);
+}
+
+// Extracts the node of task for each of its members, dropping those that
+// provably miss it. Nodes with cells bigger than the coarse grid's are only
+// bounded; from there on each node is sampled, and runs marching squares on
+// the quarters of its grid that need no refinement, leaving the rest to its
+// children. Away from the curve a handful of interval evaluations stand in
+// for thousands of samples, and near it cells are only as small as it
+// needs. Children are spawned as tasks of their own, so a deep refinement
+// around a singular point is shared out among idle workers.
+void RenderArea::runExtractionTask(const ExtractionTask& task, int worker)
+{
+    const ExtractionTile& tile = extraction_tiles[task.tile];
+    ExtractionWorker& out = extraction_workers[extracting][worker];
+    FactorCurve* curve = tile.curve;
+    QuadtreeNode* node = task.node;
+    const double x_min = task.x_min, x_max = task.x_max, y_min = task.y_min, y_max = task.y_max;
+    const int num_terms = curve->decomposition->numTerms();
+    const std::vector<Interval>& bounds = nodeBounds(curve, node, x_min, x_max, y_min, y_max);
+
+    quint64 members = 0;
+    for (int member = 0; member < tile.num_members; member++)
+    {
+        if (!(task.members >> member & 1))
+            continue;
+        const double* w = tile.w + member*num_terms;
+        Interval bound(0);
+        for (unsigned int k = 0; k < bounds.size(); k++)
+            bound = bound + bounds[k]*w[k];
+        if (bound.containsZero())
+            members |= (quint64)1 << member;
+        else
+            out.culled_cells++;
+    }
+    if (!members)
+        return;
+
+    const ExtractionSettings& settings = extraction_settings;
+    double cell_pixels = (y_max - y_min)*tile.pixels_per_unit/LEAF_RES;
+    quint64 refine[4] = { members, members, members, members };
+
+    if (cell_pixels <= settings.coarse_cell_pixels || task.level == MAX_QUADTREE_DEPTH)
+    {
+        const int n = (LEAF_RES + 1)*(LEAF_RES + 1);
+        const std::vector<double>& samples = nodeSamples(curve, task, &out.samples_taken, &out.samples_reused);
+        std::vector<double>& vals = out.vals;
+        bool can_refine = cell_pixels/2 >= settings.min_cell_pixels && task.level < MAX_QUADTREE_DEPTH;
+
+        for (int member = 0; member < tile.num_members; member++)
+        {
+            if (!(members >> member & 1))
+                continue;
+
+            // f is the dot product of w with the terms at each sample point.
+            const double* w = tile.w + member*num_terms;
+            vals.assign(n, 0.0);
+            for (unsigned int k = 0; k < bounds.size(); k++)
             {
-                int times_flopped = 0;
+                const double* term = samples.data() + k*n;
+                for (int p = 0; p < n; p++)
+                    vals[p] += w[k]*term[p];
+            }
 
-                if (val_ll*val_lr <= 0)
-                {
-                    active_vertices->push_back(QVector3D((-val_ll * xstep)/(val_lr - val_ll) + x, y, 0));
-                    times_flopped++;
-                }
-                if (val_ul*val_ur <= 0)
-                {
-                    active_vertices->push_back(QVector3D((-val_ul * xstep)/(val_ur - val_ul) + x, y + ystep, 0));
-                    times_flopped++;
-                }
-                if (val_ll*val_ul <= 0)
+            // Only the signs matter to marching squares. Where a value is
+            // within its error bound of zero its sign may be wrong, so it is
+            // recomputed in double-double; elsewhere the doubles are certain.
+            const std::vector<double>& errors = node->error_bounds;
+            double error = 0;
+            for (unsigned int k = 0; k < errors.size(); k++)
+                error += std::abs(w[k])*errors[k];
+
+            double xstep = (x_max - x_min)/LEAF_RES;
+            double ystep = (y_max - y_min)/LEAF_RES;
+            for (int p = 0; p < n; p++)
+            {
+                if (std::abs(vals[p]) <= error)
                 {
-                    active_vertices->push_back(QVector3D(x, (-val_ll * ystep)/(val_ul - val_ll) + y, 0));
-                    times_flopped++;
+                    int i = p/(LEAF_RES + 1);
+                    int j = p%(LEAF_RES + 1);
+                    vals[p] = curve->decomposition->evalPrecise(x_min + xstep*i, y_min + ystep*j, w);
+                    out.precise_samples++;
                 }
-                if (val_lr*val_ur <= 0)
+            }
+            out.leaf_samples += n;
+
+            double max_gradient = 0;
+            for (int i = 0; can_refine && i < LEAF_RES; i++)
+                for (int j = 0; j < LEAF_RES; j++)
+                    max_gradient = std::max(max_gradient, cell_gradient(vals.data(), LEAF_RES, i, j));
+
+            size_t begin = out.vertices.size();
+            const int half = LEAF_RES/2;
+            for (int q = 0; q < 4; q++)
+            {
+                int i_begin = (q & 1)*half;
+                int j_begin = (q >> 1)*half;
+                if (can_refine && cells_need_refinement(vals.data(), LEAF_RES, i_begin, i_begin + half,
+                                                        j_begin, j_begin + half, cell_pixels, max_gradient, settings))
                 {
-                    active_vertices->push_back(QVector3D(x + xstep, (-val_lr * ystep)/(val_ur - val_lr) + y, 0));
-                    times_flopped++;
+                    out.refined_cells++;
+                    continue;
                 }
+                refine[q] &= ~((quint64)1 << member);
+                addGridVertices(vals.data(), LEAF_RES, i_begin, i_begin + half, j_begin, j_begin + half,
+                                x_min, x_max, y_min, y_max, &out.vertices);
+            }
+            if (settings.newton_steps > 0 || settings.measure_vertex_error)
+                projectVertices(curve, w, xstep, tile.pixels_per_unit, begin, &out);
+            if (out.vertices.size() > begin)
+            {
+                VertexRun run = { task.tile, member, task.path, task.level, worker,
+                                  begin, out.vertices.size() - begin };
+                out.runs.push_back(run);
+            }
+        }
+    }
+
+    // The worker takes its own tasks last in first out, so these are
+    // pushed backwards to be walked in order.
+    const double xs[3] = { x_min, (x_min + x_max)/2, x_max };
+    const double ys[3] = { y_min, (y_min + y_max)/2, y_max };
+    for (int q = 3; q >= 0; q--)
+    {
+        if (!refine[q])
+            continue;
+        if (!node->children)
+            node->children.reset(new QuadtreeNode[4]);
+        int level = task.level + 1;
+        ExtractionTask child = { task.tile, &node->children[q], node, level,
+                                 2*task.ix + (q & 1), 2*task.iy + (q >> 1), xs[q & 1], xs[(q & 1) + 1], ys[q >> 1], ys[(q >> 1) + 1], refine[q],
+                                 task.path | (quint64)q << 2*(MAX_QUADTREE_DEPTH - level) };
+        scheduler->spawn(worker, child);
+    }
+}
 
-                // We want to leave an even number of vertices for this square;
-                // adjacent vertices in the list are paired into lines.
-                if (times_flopped == 1 || times_flopped == 3)
-                    active_vertices->pop_back();
+void RenderArea::projectVertices(FactorCurve* curve, const double* w, double max_step, double pixels_per_unit,
+                                 size_t begin, ExtractionWorker* out)
+{
+    const ExtractionSettings& settings = extraction_settings;
+    const int n = out->vertices.size() - begin;
+    if (n == 0)
+        return;
+
+    // Positions, then f and its gradient at them.
+    std::vector<double>& scratch = out->newton;
+    scratch.resize(5*n);
+    double* x = scratch.data();
+    double* y = x + n;
+    double* f = y + n;
+    double* df_dx = f + n;
+    double* df_dy = df_dx + n;
+    for (int p = 0; p < n; p++)
+    {
+        x[p] = out->vertices[begin + p].x();
+        y[p] = out->vertices[begin + p].y();
+    }
+
+    // Each step goes to the zero of the linearization of f along its
+    // gradient. The last pass only measures, if asked to.
+    const double max_step_squared = max_step*max_step;
+    int passes = settings.newton_steps + (settings.measure_vertex_error ? 1 : 0);
+    for (int pass = 0; pass < passes; pass++)
+    {
+        curve->decomposition->evalWithGradient(x, y, w, f, df_dx, df_dy, n);
+        bool measuring = pass == settings.newton_steps;
+        for (int p = 0; p < n; p++)
+        {
+            double gradient_squared = df_dx[p]*df_dx[p] + df_dy[p]*df_dy[p];
+            if (!(gradient_squared > 0) || !std::isfinite(gradient_squared))
+                continue;
+            double dx = -f[p]*df_dx[p]/gradient_squared;
+            double dy = -f[p]*df_dy[p]/gradient_squared;
+            double step_squared = dx*dx + dy*dy;
+            if (measuring)
+            {
+                double error = std::sqrt(step_squared)*pixels_per_unit;
+                out->vertex_error_sum += error;
+                out->max_vertex_error = std::max(out->max_vertex_error, error);
+                out->measured_vertices++;
+            }
+            else if (step_squared <= max_step_squared)
+            {
+                x[p] += dx;
+                y[p] += dy;
             }
         }
     }
 
-    delete vals;
+    for (int p = 0; p < n; p++)
+    {
+        out->vertices[begin + p].setX(x[p]);
+        out->vertices[begin + p].setY(y[p]);
+    }
 }
 
 void RenderArea::draw_functions(QOpenGLFunctions* f)
 {
+    culled_cells_this_frame = 0;
+    refined_cells_this_frame = 0;
+    precise_samples_this_frame = 0;
+    leaf_samples_this_frame = 0;
+    needed_samples_this_frame = 0;
+    reused_samples_this_frame = 0;
+    measured_vertices_this_frame = 0;
+    vertex_error_sum_this_frame = 0;
+    max_vertex_error_this_frame = 0;
+    upload_chunks_this_frame = 0;
+    backends_last_frame.clear();
+    long long allocations_before = allocationCount();
+
+    QElapsedTimer sampling_timer;
+    sampling_timer.start();
+
+    // The quadtrees are cut into tiles here, after any change of chart,
+    // and extracted node by node on the work-stealing scheduler.
+    double aspect = horizontal_scale/vertical_scale;
+    double pixels_per_unit = height()*devicePixelRatioF()/2; // The chart's y runs from -1 to 1.
+
+    // Like the workers' output, everything here is cleared rather than
+    // freed, so once it has grown to the most a frame needs, a frame like
+    // the last allocates nothing.
+    extraction_tiles.clear();
+    std::vector<unsigned int>& first_tile = extraction_first_tile;
+    first_tile.resize(functions.size() + 1);
     for (unsigned int index = 0; index < functions.size(); index++)
     {
-        if (functions[index])
+        first_tile[index] = extraction_tiles.size();
+        if (!functions[index])
+            continue;
+
+        // Members of the pencil are spread evenly around [s:t] from the
+        // current one. They share the cached samples, so each extra curve
+        // costs only the dot products and marching squares. The zero set
+        // of f is the union of those of its factors, each drawn alone.
+        // The quadtree runs over the chart of updateSampleCache.
+        for (unsigned int i = 0; i < factor_curves[index].size(); i++)
         {
-            std::vector<QVector3D> active_vertices;
+            FactorCurve* curve = factor_curves[index][i];
+            updateSampleCache(curve);
+            const char* backend = curve->decomposition->backend();
+            if (std::find(backends_last_frame.begin(), backends_last_frame.end(), backend) == backends_last_frame.end())
+                backends_last_frame.push_back(backend);
+            int num_terms = curve->decomposition->numTerms();
+            curve->weights.resize(pencil_size*num_terms);
+            for (int member = 0; member < pencil_size; member++)
+            {
+                double angle = virtual_time_elapsed + 3.1415926535*member/pencil_size;
+                curve->decomposition->weights(cos(angle), sin(angle), curve->weights.data() + member*num_terms);
+            }
+            collectTiles(curve, curve->cache.root.get(), curve->weights.data(), pencil_size, 0, 0, 0,
+                         -aspect, aspect, -1, 1, pixels_per_unit);
+        }
+    }
+    first_tile[functions.size()] = extraction_tiles.size();
+
+    // Batch by batch, the tiles are extracted into one set of worker
+    // output while the last batch's, in the other, is uploaded between
+    // this thread's tasks. Whatever of it is left is uploaded once the
+    // batch is done, and the two sets swap.
+    const int num_workers = scheduler->numWorkers();
+    for (int set = 0; set < 2; set++)
+        extraction_workers[set].resize(num_workers);
+    worker_stats_last_frame.assign(num_workers, WorkerStats());
+    extraction_runs.clear();
+    next_upload_run = 0;
+    next_upload_vertex = 0;
+    upload_function = -1;
+    upload_vertices.clear();
+    upload_vertices.reserve(UPLOAD_CHUNK_VERTICES);
+    qint64 sampling_nsecs = sampling_timer.nsecsElapsed();
+    std::vector<ExtractionTask>& tasks = extraction_tasks;
+    for (unsigned int first = 0; first < extraction_tiles.size(); first += EXTRACTION_BATCH_TILES)
+    {
+        tasks.clear();
+        unsigned int last = std::min((unsigned int)extraction_tiles.size(), first + EXTRACTION_BATCH_TILES);
+        for (unsigned int i = first; i < last; i++)
+        {
+            const ExtractionTile& tile = extraction_tiles[i];
+            quint64 all_members = tile.num_members == 64 ? ~(quint64)0 : ((quint64)1 << tile.num_members) - 1;
+            ExtractionTask task = { (int)i, tile.node, 0, tile.level, tile.ix, tile.iy, tile.x_min, tile.x_max, tile.y_min, tile.y_max,
+                                    all_members, 0 };
+            tasks.push_back(task);
+        }
 
-            const int res = 200;
+        for (int i = 0; i < num_workers; i++)
+        {
+            ExtractionWorker& worker = extraction_workers[extracting][i];
+            worker.vertices.clear();
+            worker.runs.clear();
+            worker.culled_cells = 0;
+            worker.refined_cells = 0;
+            worker.precise_samples = 0;
+            worker.leaf_samples = 0;
+            worker.samples_taken = 0;
+            worker.samples_reused = 0;
+            worker.measured_vertices = 0;
+            worker.vertex_error_sum = 0;
+            worker.max_vertex_error = 0;
+        }
+        sampling_timer.start();
+        scheduler->run(tasks, [this](const ExtractionTask& task, int worker) { runExtractionTask(task, worker); },
+                       [this, f] { uploadRuns(f, true); });
+        sampling_nsecs += sampling_timer.nsecsElapsed();
+        const std::vector<WorkerStats>& stats = scheduler->stats();
+        for (int i = 0; i < num_workers; i++)
+        {
+            worker_stats_last_frame[i].tasks += stats[i].tasks;
+            worker_stats_last_frame[i].steals += stats[i].steals;
+            worker_stats_last_frame[i].busy_nsecs += stats[i].busy_nsecs;
+        }
 
-            addVerticesPatch(index, res, -horizontal_scale, horizontal_scale, -vertical_scale, vertical_scale, &active_vertices, 0);
+        uploadRuns(f, false);
+        collectRuns(extracting);
+        extracting = 1 - extracting;
+    }
+    uploadRuns(f, false);
+    if (!upload_vertices.empty())
+        drawVertexChunk(f, upload_vertices);
+    // That includes the uploads done between this thread's tasks.
+    sampling_nsecs_this_second += sampling_nsecs;
+
+    culled_cells_last_frame = culled_cells_this_frame;
+    refined_cells_last_frame = refined_cells_this_frame;
+    precise_samples_last_frame = precise_samples_this_frame;
+    leaf_samples_last_frame = leaf_samples_this_frame;
+    needed_samples_last_frame = needed_samples_this_frame;
+    reused_samples_last_frame = reused_samples_this_frame;
+    measured_vertices_last_frame = measured_vertices_this_frame;
+    vertex_error_sum_last_frame = vertex_error_sum_this_frame;
+    max_vertex_error_last_frame = max_vertex_error_this_frame;
+    allocations_last_frame = allocationCount() - allocations_before;
+    upload_chunks_last_frame = upload_chunks_this_frame;
+}
 
-            int num_vertices = active_vertices.size() < MAX_NUM_VERTICES ? active_vertices.size() : MAX_NUM_VERTICES;
+void RenderArea::collectRuns(int set)
+{
+    // Sorting the runs puts the vertices in the same order whichever
+    // worker made them. The last set's runs have all been uploaded.
+    std::vector<VertexRun>& runs = extraction_runs;
+    runs.clear();
+    next_upload_run = 0;
+    next_upload_vertex = 0;
+    for (unsigned int i = 0; i < extraction_workers[set].size(); i++)
+    {
+        const ExtractionWorker& worker = extraction_workers[set][i];
+        runs.insert(runs.end(), worker.runs.begin(), worker.runs.end());
+        culled_cells_this_frame += worker.culled_cells;
+        refined_cells_this_frame += worker.refined_cells;
+        precise_samples_this_frame += worker.precise_samples;
+        leaf_samples_this_frame += worker.leaf_samples;
+        samples_this_second += worker.samples_taken;
+        needed_samples_this_frame += worker.samples_taken + worker.samples_reused;
+        reused_samples_this_frame += worker.samples_reused;
+        measured_vertices_this_frame += worker.measured_vertices;
+        vertex_error_sum_this_frame += worker.vertex_error_sum;
+        max_vertex_error_this_frame = std::max(max_vertex_error_this_frame, worker.max_vertex_error);
+    }
+    std::sort(runs.begin(), runs.end());
+}
 
-            for (int i = 0; i < num_vertices; i++)
+void RenderArea::uploadRuns(QOpenGLFunctions* f, bool one_chunk)
+{
+    // The runs are copied in order, scaled to the screen. Chunks hold an
+    // even number of vertices, so no line is split between two, and each
+    // is of one function, drawn in its color.
+    const std::vector<ExtractionWorker>& workers = extraction_workers[1 - extracting];
+    const std::vector<unsigned int>& first_tile = extraction_first_tile;
+    std::vector<QVector3D>& chunk = upload_vertices;
+    double aspect = horizontal_scale/vertical_scale;
+    while (next_upload_run < extraction_runs.size())
+    {
+        const VertexRun& run = extraction_runs[next_upload_run];
+        if ((unsigned int)run.tile >= first_tile[upload_function + 1])
+        {
+            bool drew = !chunk.empty();
+            if (drew)
             {
-                active_vertices[i].setX(active_vertices[i].x() / horizontal_scale);
-                active_vertices[i].setY(active_vertices[i].y() / vertical_scale);
+                drawVertexChunk(f, chunk);
+                chunk.clear();
             }
-
+            while ((unsigned int)run.tile >= first_tile[upload_function + 1])
+                upload_function++;
             f->glLineWidth(3.0f);
-            f->glEnableVertexAttribArray(0);
-
-            f->glBindBuffer(GL_ARRAY_BUFFER, vbuffer_handle);
-            f->glVertexAttribPointer(
-                        0,
-                        3,
-                        GL_FLOAT,
-                        GL_FALSE,
-                        0,
-                        (void*)0
-            );
-
-            f->glBufferData(GL_ARRAY_BUFFER, sizeof(float)*num_vertices*3, (float*)active_vertices.data(), GL_DYNAMIC_DRAW);
-
-            f->glUniform3fv(vertexColor_handle, 1, (float*)&(function_colors[index]));
-
-            f->glDrawArrays(GL_LINES, 0, num_vertices);
-
-            f->glDisableVertexAttribArray(0);
-            f->glDisableVertexAttribArray(1);
+            f->glUniform3fv(vertexColor_handle, 1, (float*)&(function_colors[upload_function]));
+            if (drew && one_chunk)
+                return;
+        }
 
-            //delete vertex_array;
+        const QVector3D* vertices = workers[run.worker].vertices.data() + run.begin;
+        size_t n = std::min(run.count - next_upload_vertex, UPLOAD_CHUNK_VERTICES - chunk.size());
+        for (size_t i = next_upload_vertex; i < next_upload_vertex + n; i++)
+            chunk.push_back(QVector3D(vertices[i].x()/aspect, vertices[i].y(), vertices[i].z()));
+        next_upload_vertex += n;
+        if (next_upload_vertex == run.count)
+        {
+            next_upload_run++;
+            next_upload_vertex = 0;
+        }
+        if (chunk.size() == UPLOAD_CHUNK_VERTICES)
+        {
+            drawVertexChunk(f, chunk);
+            chunk.clear();
+            if (one_chunk)
+                return;
         }
     }
 }
 
+void RenderArea::drawVertexChunk(QOpenGLFunctions* f, const std::vector<QVector3D>& chunk)
+{
+    // The buffer drawn from last is likely still being read, so this one
+    // is a different one, the least recently used. That may still be read
+    // too, once the ring has wrapped, so its storage is orphaned first.
+    GLuint buffer = upload_buffers[next_upload_buffer];
+    next_upload_buffer = (next_upload_buffer + 1) % NUM_UPLOAD_BUFFERS;
+    f->glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    f->glBufferData(GL_ARRAY_BUFFER, sizeof(float)*UPLOAD_CHUNK_VERTICES*3, 0, GL_STREAM_DRAW);
+
+    // Only the call is timed; the driver may copy to the GPU later.
+    QElapsedTimer upload_timer;
+    upload_timer.start();
+    f->glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float)*chunk.size()*3, (float*)chunk.data());
+    upload_nsecs_this_second += upload_timer.nsecsElapsed();
+    upload_bytes_this_second += sizeof(float)*chunk.size()*3;
+    upload_chunks_this_frame++;
+
+    f->glEnableVertexAttribArray(0);
+    f->glVertexAttribPointer(
+                0,
+                3,
+                GL_FLOAT,
+                GL_FALSE,
+                0,
+                (void*)0
+    );
+    f->glDrawArrays(GL_LINES, 0, chunk.size());
+    f->glDisableVertexAttribArray(0);
+}
+
 void RenderArea::add_line_vertices(float a, float b, float c, std::vector<QVector3D>* vertex_vector)
 {
     // Check if line not visible. (Nearest point is farther from 0 than length of diagonal)
@@ -400,7 +1197,7 @@ void RenderArea::draw_axes(QOpenGLFunctions* f)
     std::vector<QVector3D> vertex_vector;
     std::vector<QVector3D> color_vector;
 
-    const float* m = view_rotation.constData();
+    const double* m = view_rotation.constData();
 
     /*std::cout << m[0 + 0*4] << ", " << m[0 + 1*4] << ", " << m[0 + 2*4] << std::endl;
     std::cout << m[1 + 0*4] << ", " << m[1 + 1*4] << ", " << m[1 + 2*4] << std::endl;
@@ -474,6 +1271,42 @@ void RenderArea::paintGL()
         std::cout << "FPS: " << frames_this_second
                   << ", msec/frame: " << (double)startOfSecond.elapsed() / frames_this_second << std::endl;
         std::cout << "This frame: " << beforeFrame.elapsed() << " msecs." << std::endl;
+        if (print_frame_stats)
+        {
+            if (sampling_nsecs_this_second > 0)
+            {
+                std::cout << "Samples/sec (" << thread_pool->numThreads() << " threads";
+                for (unsigned int i = 0; i < backends_last_frame.size(); i++)
+                    std::cout << ", " << backends_last_frame[i];
+                std::cout << "): " << samples_this_second * 1e9 / sampling_nsecs_this_second << std::endl;
+            }
+            std::cout << "Culled cells this frame: " << culled_cells_last_frame
+                      << ", refined: " << refined_cells_last_frame << std::endl;
+            if (needed_samples_last_frame > 0)
+                std::cout << "Term samples reused from parents and neighbours this frame: " << reused_samples_last_frame
+                          << " of " << needed_samples_last_frame << std::endl;
+            if (measured_vertices_last_frame > 0)
+                std::cout << "Vertex error this frame (" << extraction_settings.newton_steps << " Newton steps): mean "
+                          << meanVertexErrorLastFrame() << " px, max " << max_vertex_error_last_frame << " px" << std::endl;
+            if (upload_nsecs_this_second > 0)
+                std::cout << "Vertex upload (CPU time in glBufferSubData): "
+                          << upload_bytes_this_second*1e3/upload_nsecs_this_second << " MB/s, " << upload_chunks_last_frame << " chunks this frame" << std::endl;
+#ifdef COUNT_ALLOCATIONS
+            std::cout << "Heap allocations drawing functions this frame: " << allocations_last_frame << std::endl;
+#endif
+            std::cout << "Tasks stolen this frame: " << stealsLastFrame() << ", busy msecs per thread:";
+            for (unsigned int i = 0; i < worker_stats_last_frame.size(); i++)
+                std::cout << " " << worker_stats_last_frame[i].busy_nsecs*1e-6;
+            std::cout << std::endl;
+            if (leaf_samples_last_frame > 0)
+                std::cout << "Double-double fallback this frame: " << precise_samples_last_frame << " of "
+                          << leaf_samples_last_frame << " samples ("
+                          << 100.0*precise_samples_last_frame/leaf_samples_last_frame << "%)" << std::endl;
+        }
+        samples_this_second = 0;
+        sampling_nsecs_this_second = 0;
+        upload_bytes_this_second = 0;
+        upload_nsecs_this_second = 0;
         startOfSecond.start();
         frames_this_second = 0;
     }
@@ -481,53 +1314,63 @@ void RenderArea::paintGL()
     this->update();
 }
 
-QMatrix4x4 rotation_between(QVector3D v1, QVector3D v2)
+// The rotation taking the direction of (x1, y1, 1) to that of (x2, y2, 1),
+// about their cross product, as QMatrix4x4::rotate would make it.
+ViewMatrix rotation_between(double x1, double y1, double x2, double y2)
 {
-    QMatrix4x4 rot_diff;
-
-    v1.normalize();
-    v2.normalize();
-
-    QVector3D v = QVector3D::crossProduct(v1,
-                                          v2);
-
-    if (QVector3D::dotProduct(v1, v2) > 0)
-        rot_diff.rotate(asin(v.length())*180/3.1415926535, v);
-    else
-        rot_diff.rotate(180 - asin(v.length())*180/3.1415926535, v);
+    double axis[3] = { y1 - y2, x2 - x1, x1*y2 - y1*x2 };
+    double length = sqrt(axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2]);
+    ViewMatrix rot_diff;
+    if (length == 0)
+        return rot_diff;
+
+    double angle = atan2(length, x1*x2 + y1*y2 + 1);
+    double c = cos(angle);
+    double s = sin(angle);
+    for (int i = 0; i < 3; i++)
+        axis[i] /= length;
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+            rot_diff(i, j) = axis[i]*axis[j]*(1 - c) + (i == j ? c : 0);
+    }
+    rot_diff(0, 1) -= axis[2]*s;
+    rot_diff(1, 0) += axis[2]*s;
+    rot_diff(0, 2) += axis[1]*s;
+    rot_diff(2, 0) -= axis[1]*s;
+    rot_diff(1, 2) -= axis[0]*s;
+    rot_diff(2, 1) += axis[0]*s;
 
     return rot_diff;
 }
 
-QMatrix4x4 translation_between(QVector3D v1, QVector3D v2)
+ViewMatrix translation_between(double x1, double y1, double x2, double y2)
 {
-    QVector3D diff = v2 - v1;
-
-    return QMatrix4x4(1, 0, 0, diff.x(),
-                      0, 1, 0, diff.y(),
-                      0, 0, 1, diff.z(),
-                      0, 0, 0, 1);
+    const double values[16] = { 1, 0, 0, x2 - x1,
+                                0, 1, 0, y2 - y1,
+                                0, 0, 1, 0,
+                                0, 0, 0, 1 };
+    return ViewMatrix(values);
 }
 
 void RenderArea::mouseMoveEvent(QMouseEvent *event)
 {
     if (event->buttons() & Qt::LeftButton)
     {
-        float mouse_now_x = (event->x()/(this->width()*0.5f) - 1.0f)*horizontal_scale;
-        float mouse_now_y = -(event->y()/(this->height()*0.5f) - 1.0f)*vertical_scale;
-
-        QVector3D v1 = QVector3D(mouse_now_x,mouse_now_y,1);
-        QVector3D v2 = QVector3D(mouse_clicked_x, mouse_clicked_y, 1);
+        double mouse_now_x = (event->x()/(this->width()*0.5) - 1.0)*horizontal_scale;
+        double mouse_now_y = -(event->y()/(this->height()*0.5) - 1.0)*vertical_scale;
 
         Qt::KeyboardModifiers mods = QGuiApplication::keyboardModifiers();
         if (!(mods & Qt::ShiftModifier))
         {   // Rotate
-            view_rotation = view_rotation_clicked*rotation_between(v1, v2);
+            view_rotation = view_rotation_clicked*rotation_between(mouse_now_x, mouse_now_y,
+                                                                   mouse_clicked_x, mouse_clicked_y);
         }
         else
         {   // Translate.
             // Warning: this currently translates the curves, but not the axes.
-            view_rotation = view_rotation_clicked*translation_between(v1, v2);
+            view_rotation = view_rotation_clicked*translation_between(mouse_now_x, mouse_now_y,
+                                                                      mouse_clicked_x, mouse_clicked_y);
         }
     }
     this->update();
@@ -537,8 +1380,8 @@ void RenderArea::mousePressEvent(QMouseEvent *event)
 {
     view_rotation_clicked = view_rotation;
 
-    mouse_clicked_x = (event->x()/(this->width()*0.5f) - 1.0f)*horizontal_scale;
-    mouse_clicked_y = -(event->y()/(this->height()*0.5f) - 1.0f)*vertical_scale;
+    mouse_clicked_x = (event->x()/(this->width()*0.5) - 1.0)*horizontal_scale;
+    mouse_clicked_y = -(event->y()/(this->height()*0.5) - 1.0)*vertical_scale;
 
 }
 
@@ -554,26 +1397,23 @@ void RenderArea::wheelEvent(QWheelEvent *event)
         // Qt::KeyboardModifiers mods = QGuiApplication::keyboardModifiers();
 
         // Zoom in/out
-        float old_vertical_scale = vertical_scale;
-        float old_horizontal_scale = horizontal_scale;
+        double old_vertical_scale = vertical_scale;
+        double old_horizontal_scale = horizontal_scale;
         this->setYScale(vertical_scale*pow(1.001,-event->delta()));
 
         // Adjust rotation so that cursor remains at same projective point.
         QPoint cursor_pos = this->mapFromGlobal(QCursor::pos());
 
-        float mouse_x_orig = (cursor_pos.x()/(this->width()*0.5f) - 1.0f)*old_horizontal_scale;
-        float mouse_y_orig = -(cursor_pos.y()/(this->height()*0.5f) - 1.0f)*old_vertical_scale;
+        double mouse_x_orig = (cursor_pos.x()/(this->width()*0.5) - 1.0)*old_horizontal_scale;
+        double mouse_y_orig = -(cursor_pos.y()/(this->height()*0.5) - 1.0)*old_vertical_scale;
 
-        float mouse_x_now = (cursor_pos.x()/(this->width()*0.5f) - 1.0f)*horizontal_scale;
-        float mouse_y_now = -(cursor_pos.y()/(this->height()*0.5f) - 1.0f)*vertical_scale;
+        double mouse_x_now = (cursor_pos.x()/(this->width()*0.5) - 1.0)*horizontal_scale;
+        double mouse_y_now = -(cursor_pos.y()/(this->height()*0.5) - 1.0)*vertical_scale;
 
         std::cout << "(" << mouse_x_orig << ", " << mouse_y_orig << ") -> ("
                          << mouse_x_now << ", " << mouse_y_now << ")" << std::endl;
 
-        QVector3D v1 = QVector3D(mouse_x_orig, mouse_y_orig, 1);
-        QVector3D v2 = QVector3D(mouse_x_now, mouse_y_now, 1);
-
-        view_rotation = view_rotation*rotation_between(v2, v1);
+        view_rotation = view_rotation*rotation_between(mouse_x_now, mouse_y_now, mouse_x_orig, mouse_y_orig);
     }
     std::cout << vertical_scale << std::endl;
     update();
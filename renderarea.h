@@ -12,8 +12,21 @@
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
 #include <QMatrix4x4>
+#include <QGenericMatrix>
 #include <QTime>
+#include <memory>
 #include "term.h"
+#include "stdecomposition.h"
+#include "factorization.h"
+#include "compiledfunction.h"
+#include "threadpool.h"
+#include "workstealing.h"
+#include "edgesamplestore.h"
+
+// The view, taking the screen point (x, y) to view*(x, y, 1, 1). It is
+// kept in double: in float, below a scale of about 1e-7, the view's centre
+// and the rotations of a pan or zoom by a few pixels are rounded away.
+typedef QGenericMatrix<4, 4, double> ViewMatrix;
 
 class RenderArea : public QOpenGLWidget
 {
@@ -22,15 +35,87 @@ public:
     explicit RenderArea(QWidget *parent = 0);
     ~RenderArea();
 
-    // Warning: takes control of the pointer f, so generally send in a clone.
-    void setFunction(int index, Term* f);
+    // Each square-free factor of f is drawn on its own. A null f draws
+    // nothing. f is shared, not copied.
+    void setFunction(int index, const SharedFunction& f);
     void setFunctionColor(int index, QVector3D color);
     void addFunction(QVector3D color);
     void deleteFunction(int index);
     void setVirtualTimeFactor(double new_virtual_time_factor) { this->virtual_time_factor = new_virtual_time_factor; }
 
 
-    void setYScale(float newScale);
+    void setYScale(double newScale);
+
+    // How the quadtree decides where to sample, in device pixels of the
+    // viewport. Regions bigger than a coarse grid cell are only bounded,
+    // with interval arithmetic; below that each quadtree node is sampled
+    // as a LEAF_RES by LEAF_RES grid, and quarters of it with cells that
+    // meet a criterion below are sampled again at twice the resolution,
+    // down to min_cell_pixels. So away from the curve nothing is sampled,
+    // and near it cells shrink only where the curve needs them to.
+    struct ExtractionSettings
+    {
+        double coarse_cell_pixels = 8;
+        double min_cell_pixels = 0.5;
+        // Refine every cell the curve crosses.
+        bool refine_crossings = false;
+        // Refine crossed cells whose segment may be farther than this from
+        // the curve, estimated from second differences of the samples.
+        double max_chord_error_pixels = 0.25;
+        // Refine cells within about a cell of the curve where the gradient
+        // is below this fraction of its largest size on the grid. That is
+        // near singular points, tangent branches and small ovals, where
+        // marching squares can miss or misjoin branches.
+        double min_relative_gradient = 0.1;
+        // Newton steps that move each vertex from where marching squares
+        // interpolated it onto the curve, along the gradient. With a few,
+        // a coarser grid draws as accurately as a finer one without them.
+        int newton_steps = 0;
+        // Estimate how far each vertex is from the curve once placed, as
+        // |f|/|gradient of f|, at the cost of one more evaluation of f and
+        // its gradient per vertex.
+        bool measure_vertex_error = false;
+    };
+    void setExtractionSettings(const ExtractionSettings& settings) { extraction_settings = settings; }
+    const ExtractionSettings& extractionSettings() const { return extraction_settings; }
+
+    // Curves are extracted by this many threads at most, counting the GUI
+    // thread. 0 means one per core.
+    void setMaxThreads(int n);
+    int numThreads() const { return thread_pool->numThreads(); }
+    // How the work of the last frame was spread over the threads, one
+    // entry per thread, and how many tasks were stolen in all.
+    const std::vector<WorkerStats>& workerStatsLastFrame() const { return worker_stats_last_frame; }
+    long stealsLastFrame() const;
+
+    // Quadtree cells skipped in the last frame because f provably has no
+    // zero in them, summed over all functions.
+    int culledCellsLastFrame() const { return culled_cells_last_frame; }
+    // Quarters of sampled cells that were sampled again more finely.
+    int refinedCellsLastFrame() const { return refined_cells_last_frame; }
+    // Of the leaf samples used in the last frame, how many were too close
+    // to zero for their sign to be trusted and were redone in
+    // double-double, and how many there were in all.
+    long preciseSamplesLastFrame() const { return precise_samples_last_frame; }
+    long leafSamplesLastFrame() const { return leaf_samples_last_frame; }
+    // Term samples the last frame needed for newly sampled nodes, and how
+    // many of them were copied from a parent or a neighbour instead of
+    // evaluated again.
+    long neededSamplesLastFrame() const { return needed_samples_last_frame; }
+    long reusedSamplesLastFrame() const { return reused_samples_last_frame; }
+    // With measure_vertex_error, the mean and largest distance in device
+    // pixels of the last frame's vertices from their curves, to first
+    // order, and how many vertices were measured.
+    double meanVertexErrorLastFrame() const;
+    double maxVertexErrorLastFrame() const { return max_vertex_error_last_frame; }
+    long measuredVerticesLastFrame() const { return measured_vertices_last_frame; }
+    // Calls to operator new, from any thread, while drawing the functions
+    // in the last frame. Scratch space is kept from frame to frame, so
+    // this is 0 unless the view moved, a function changed or the curves
+    // reached nodes of the quadtree not yet sampled.
+    long long allocationsLastFrame() const { return allocations_last_frame; }
+    // How many chunks of vertices were sent to the GPU in the last frame.
+    int uploadChunksLastFrame() const { return upload_chunks_last_frame; }
 
 signals:
 
@@ -48,10 +133,41 @@ protected:
         return QSize(1000,1000);
     }
 
-    void addVerticesPatch(int index, int res, double x_min, double x_max, double y_min, double y_max, std::vector<QVector3D>* active_vertices,
-                                      int recursion_depth = 0);
+    // Runs marching squares on the cells [i_begin, i_end) by [j_begin, j_end)
+    // of a res by res grid of values over the rectangle.
+    void addGridVertices(const double* vals, int res, int i_begin, int i_end, int j_begin, int j_end,
+                         double x_min, double x_max, double y_min, double y_max,
+                         std::vector<QVector3D>* active_vertices);
+    struct FactorCurve;
+    struct QuadtreeNode;
+    struct ExtractionTask;
+    void collectTiles(FactorCurve* curve, QuadtreeNode* node, const double* w, int num_members,
+                      int level, int ix, int iy, double x_min, double x_max, double y_min, double y_max,
+                      double pixels_per_unit);
+    void runExtractionTask(const ExtractionTask& task, int worker);
+    struct ExtractionWorker;
+    // Moves the vertices of out from begin on, all of one member, onto
+    // the curve with the Newton steps of the extraction settings. Steps
+    // longer than max_step are taken for a jump to another branch, and
+    // leave the vertex where it was.
+    void projectVertices(FactorCurve* curve, const double* w, double max_step, double pixels_per_unit,
+                         size_t begin, ExtractionWorker* out);
+    void updateSampleCache(FactorCurve* curve);
+    const std::vector<Interval>& nodeBounds(FactorCurve* curve, QuadtreeNode* node,
+                                            double x_min, double x_max, double y_min, double y_max);
+    const std::vector<double>& nodeSamples(FactorCurve* curve, const ExtractionTask& task,
+                                           long* samples_taken, long* samples_reused);
 
     void draw_functions(QOpenGLFunctions* f);
+    // Adds the runs of the set of worker output just extracted, sorted, to
+    // be uploaded next, and its stats to the frame's.
+    void collectRuns(int set);
+    // Copies the runs collected, from where the last call stopped, into
+    // the chunk being filled, and draws each chunk as it fills. With
+    // one_chunk it returns after drawing one.
+    void uploadRuns(QOpenGLFunctions* f, bool one_chunk);
+    // Copies chunk to the next buffer of the upload ring and draws it.
+    void drawVertexChunk(QOpenGLFunctions* f, const std::vector<QVector3D>& chunk);
     void draw_axes(QOpenGLFunctions* f);
     void add_line_vertices(float a, float b, float c, std::vector<QVector3D>* vertex_vector);
     void free_function_data();
@@ -63,21 +179,166 @@ protected:
     QMatrix4x4 projection;
     GLuint vbuffer_handle;
     GLint vertexColor_handle;
-    std::vector<Term*> functions;
+    std::vector<SharedFunction> functions;
+    int pencil_size = 1; // Number of curves drawn from each function's pencil.
+
+    // What the terms of a decomposition look like over one cell of the
+    // quadtree. Everything is filled in as the quadtree first reaches it.
+    struct QuadtreeNode
+    {
+        std::vector<Interval> bounds; // One per term.
+        std::vector<double> samples; // Of the LEAF_RES grid, as from evalTermsGrid.
+        std::vector<double> error_bounds; // One per term, from evalTermsGrid.
+        // As error_bounds, but only for the samples this node evaluated or
+        // took from its parent. Its edges are stored with these, so bounds
+        // are not passed along a row of neighbours.
+        std::vector<double> own_error_bounds;
+        // The quarters: lower left, lower right, upper left, upper right.
+        std::unique_ptr<QuadtreeNode[]> children;
+    };
+    // The quadtree of the screen, kept until the view moves. It is in the
+    // chart's coordinates, so resizing the window or changing the
+    // extraction settings only changes which nodes are visited.
+    struct SampleCache
+    {
+        ViewMatrix view_rotation;
+        double horizontal_scale = 0;
+        double vertical_scale = 0;
+        std::unique_ptr<QuadtreeNode> root; // 0 until sampled.
+        EdgeSampleStore edges; // Of sampled nodes, for their neighbours.
+    };
+    // One square-free factor of a function, split by powers of s and t for
+    // sampling. A factor that survives an edit of its function keeps its
+    // curve, samples and all.
+    struct FactorCurve
+    {
+        Polynomial polynomial;
+        STDecomposition* decomposition;
+        SampleCache cache;
+        std::vector<double> weights; // Of the terms, for each member of the pencil this frame.
+    };
+    std::vector<std::vector<FactorCurve*> > factor_curves; // Per function.
+    // A subtree of one curve's quadtree, where extraction starts. Tiles
+    // fix the order the vertices come out in.
+    struct ExtractionTile
+    {
+        FactorCurve* curve;
+        QuadtreeNode* node;
+        const double* w; // num_members sets of term weights, one after another.
+        int num_members;
+        int level;
+        int ix, iy; // Position of node among the 2^level by 2^level of its level.
+        double x_min, x_max, y_min, y_max;
+        double pixels_per_unit; // Device pixels per unit of the chart.
+    };
+    // One node of a tile, to be walked for the members of the pencil whose
+    // bits are set in members. Only a node's own task writes to it, and
+    // only the task of its parent spawns that, so tasks need no locks.
+    struct ExtractionTask
+    {
+        int tile;
+        QuadtreeNode* node;
+        const QuadtreeNode* parent; // 0 for the top of a tile.
+        int level;
+        int ix, iy;
+        double x_min, x_max, y_min, y_max;
+        quint64 members;
+        // Which quarter was taken at each level below the tile's top, two
+        // bits a level from the high end, so deeper levels sort later.
+        quint64 path;
+    };
+    // The vertices of one member of the pencil from one node, in the
+    // output of the worker that made them. Sorted, runs fall in the order
+    // of a depth-first walk of each tile, member by member.
+    struct VertexRun
+    {
+        int tile;
+        int member;
+        quint64 path;
+        int level;
+        int worker;
+        size_t begin;
+        size_t count;
+
+        bool operator<(const VertexRun& other) const
+        {
+            if (tile != other.tile)
+                return tile < other.tile;
+            if (member != other.member)
+                return member < other.member;
+            if (path != other.path)
+                return path < other.path;
+            return level < other.level;
+        }
+    };
+    // What one worker of the scheduler writes to during a frame.
+    struct ExtractionWorker
+    {
+        std::vector<QVector3D> vertices;
+        std::vector<VertexRun> runs;
+        std::vector<double> vals; // Scratch for one member's samples.
+        std::vector<double> newton; // Scratch for projectVertices.
+        int culled_cells = 0;
+        int refined_cells = 0;
+        long precise_samples = 0;
+        long leaf_samples = 0;
+        long samples_taken = 0; // Term samples computed, not read from the cache.
+        long samples_reused = 0; // Copied from a parent or neighbour rather than computed.
+        long measured_vertices = 0;
+        double vertex_error_sum = 0; // In device pixels.
+        double max_vertex_error = 0;
+    };
+    std::vector<ExtractionTile> extraction_tiles; // Of this frame.
+    std::vector<unsigned int> extraction_first_tile; // Per function, and one past the last.
+    std::vector<ExtractionTask> extraction_tasks; // The tops of the tiles of a batch.
+    // Tiles are extracted in batches, into two sets of worker output in
+    // turn: while the workers fill one, the thread drawing uploads the
+    // other between its own tasks.
+    std::vector<ExtractionWorker> extraction_workers[2];
+    int extracting = 0; // The set being filled.
+    std::vector<VertexRun> extraction_runs; // Of the other set, sorted.
+    size_t next_upload_run = 0;
+    size_t next_upload_vertex = 0; // Of that run.
+    int upload_function = -1; // Whose color is set.
+    std::vector<QVector3D> upload_vertices; // The chunk being filled, for the GPU.
+    std::unique_ptr<ThreadPool> thread_pool;
+    std::unique_ptr<WorkStealingScheduler<ExtractionTask> > scheduler;
+    std::vector<WorkerStats> worker_stats_last_frame;
     std::vector<QVector3D> function_colors;
 
-    const GLuint MAX_NUM_VERTICES = 100000;
+    // Curves of any size are drawn in chunks of UPLOAD_CHUNK_VERTICES, each
+    // copied to the next of a ring of buffers. The ring wraps every few
+    // chunks, so each buffer is orphaned before it is written: if the GPU
+    // is still drawing from it, the driver gives it new storage rather
+    // than making the upload wait. The workers' output holds two batches
+    // of EXTRACTION_BATCH_TILES tiles, however big the frame.
+    static const int NUM_UPLOAD_BUFFERS = 4;
+    static const int EXTRACTION_BATCH_TILES = 8;
+    static const size_t UPLOAD_CHUNK_VERTICES = 1 << 16; // Even, as lines are pairs.
+    GLuint upload_buffers[NUM_UPLOAD_BUFFERS];
+    int next_upload_buffer = 0;
     const GLuint HORIZONTAL_RESOLUTION = 100;
     const GLuint VERTICAL_RESOLUTION = 100;
+    // Each sampled node is a LEAF_RES by LEAF_RES grid of cells. However
+    // small the pixels, refinement stops at MAX_QUADTREE_DEPTH.
+    static const int LEAF_RES = 16;
+    static const int MAX_QUADTREE_DEPTH = 24;
+    // Quadtrees are cut into tiles at this depth, or above it where cells
+    // reach the coarse grid. It does not depend on the number of threads,
+    // so neither do the vertices.
+    static const int TILE_LEVEL = 3;
+    // Members of a pencil are tracked in the bits of a quint64.
+    static const int MAX_PENCIL_SIZE = 64;
+    ExtractionSettings extraction_settings;
 
-    float vertical_scale = 2.001f;
-    float horizontal_scale = 2.001f;
-    QMatrix4x4 view_rotation;
+    double vertical_scale = 2.001;
+    double horizontal_scale = 2.001;
+    ViewMatrix view_rotation;
 
-    QMatrix4x4 view_rotation_clicked;
+    ViewMatrix view_rotation_clicked;
 
-    float mouse_clicked_x = 0;
-    float mouse_clicked_y = 0;
+    double mouse_clicked_x = 0;
+    double mouse_clicked_y = 0;
 
     QTime start;
     QTime last_frame_time;
@@ -88,6 +349,35 @@ protected:
 
     QTime startOfSecond;
     int frames_this_second;
+    bool print_frame_stats = false;
+    long samples_this_second = 0;
+    qint64 sampling_nsecs_this_second = 0; // Time spent extracting curves, for samples/sec.
+    long long upload_bytes_this_second = 0;
+    qint64 upload_nsecs_this_second = 0; // CPU time in glBufferSubData, not the transfer.
+    int upload_chunks_this_frame = 0;
+    int upload_chunks_last_frame = 0;
+    // Of each curve drawn in the last frame, as from STDecomposition::backend,
+    // without repeats.
+    std::vector<const char*> backends_last_frame;
+    int culled_cells_this_frame = 0;
+    int culled_cells_last_frame = 0;
+    int refined_cells_this_frame = 0;
+    int refined_cells_last_frame = 0;
+    long precise_samples_this_frame = 0;
+    long precise_samples_last_frame = 0;
+    long leaf_samples_this_frame = 0;
+    long leaf_samples_last_frame = 0;
+    long needed_samples_this_frame = 0;
+    long needed_samples_last_frame = 0;
+    long reused_samples_this_frame = 0;
+    long reused_samples_last_frame = 0;
+    long measured_vertices_this_frame = 0;
+    long measured_vertices_last_frame = 0;
+    double vertex_error_sum_this_frame = 0;
+    double vertex_error_sum_last_frame = 0;
+    double max_vertex_error_this_frame = 0;
+    double max_vertex_error_last_frame = 0;
+    long long allocations_last_frame = 0;
 };
 
 #endif // RENDERAREA_H
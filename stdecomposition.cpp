@@ -0,0 +1,186 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "stdecomposition.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "binaryop.h"
+
+STDecomposition::STDecomposition(const Polynomial& f)
+{
+    parts = f.splitST(&s_exponents, &t_exponents);
+    degree = f.degree();
+    fixed_batch = fixedDegreeBatch(degree);
+
+    const double identity[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+    setChart(identity);
+}
+
+STDecomposition::~STDecomposition()
+{
+    clearChart();
+}
+
+void STDecomposition::clearChart()
+{
+    terms.clear();
+    absolute_terms.clear();
+    absolute_sums.clear();
+    fixed_coefficients.clear();
+    arena.reset();
+}
+
+void STDecomposition::weights(double s, double t, double* w) const
+{
+    for (unsigned int k = 0; k < parts.size(); k++)
+        w[k] = powi(s, s_exponents[k])*powi(t, t_exponents[k]);
+}
+
+void STDecomposition::setChart(const double map[3][3])
+{
+    clearChart();
+
+    for (int v = 0; v < 3; v++)
+    {
+        for (int w = 0; w < 3; w++)
+            chart[v][w] = map[v][w];
+    }
+
+    // Each rounding in evaluating a charted f_k, or in the dot product
+    // after, is relative to a sum of absolute values that the charted
+    // |f_k| bounds; no chain of them is longer than the Horner steps in x
+    // and y, the dot product and the rounding of the coefficients. Charting
+    // in double-double is the same, relative to |f_k| composed with |chart|,
+    // in steps of the unit roundoff squared. A count of roundings n gives
+    // gamma_n = n*u/(1 - n*u).
+    const double u = DBL_EPSILON/2;
+    double n = 4.0*degree + parts.size() + 8;
+    evaluation_error = n*u < 0.5 ? n*u/(1 - n*u) : HUGE_VAL;
+    charting_error = (6.0*degree + 16)*8*u*u;
+
+    for (unsigned int k = 0; k < parts.size(); k++)
+    {
+        Polynomial charted = parts[k].onChart(map);
+        terms.push_back(charted.toTerm(&arena));
+        absolute_terms.push_back(charted.absolute());
+
+        double sum = 0;
+        const std::vector<Polynomial::Monomial>& monomials = parts[k].getMonomials();
+        for (unsigned int i = 0; i < monomials.size(); i++)
+            sum += std::abs(monomials[i].coefficient);
+        absolute_sums.push_back(sum);
+
+        // A charted term has only x and y, so this always succeeds.
+        fixed_coefficients.push_back(std::vector<double>());
+        fixedDegreeCoefficients(charted, degree, &fixed_coefficients[k]);
+    }
+}
+
+void STDecomposition::evalTermsBatch(const double* x, const double* y, double* out, int n) const
+{
+    for (unsigned int k = 0; k < parts.size(); k++)
+        fixed_batch(fixed_coefficients[k].data(), x, y, out + k*n, n);
+}
+
+Interval STDecomposition::boundTerm(int k, const Interval& x, const Interval& y) const
+{
+    return terms[k]->evalInterval(x, y, Interval(1), 0, 0);
+}
+
+void STDecomposition::evalTermsGrid(double x_min, double x_step, int nx, double y_min, double y_step, int ny,
+                                    double* out, double* errors) const
+{
+    const int n = nx*ny;
+    double max_abs_x = std::max(std::abs(x_min), std::abs(x_min + x_step*(nx - 1)));
+    double max_abs_y = std::max(std::abs(y_min), std::abs(y_min + y_step*(ny - 1)));
+
+    if (degree < MIN_GRID_DEGREE)
+    {
+        static thread_local std::vector<double> x, y;
+        x.resize(n);
+        y.resize(n);
+        for (int i = 0; i < nx; i++)
+        {
+            for (int j = 0; j < ny; j++)
+            {
+                x[i*ny + j] = x_min + x_step*i;
+                y[i*ny + j] = y_min + y_step*j;
+            }
+        }
+        evalTermsBatch(x.data(), y.data(), out, n);
+        for (unsigned int k = 0; k < parts.size(); k++)
+            errors[k] = errorBound(k, max_abs_x, max_abs_y);
+        return;
+    }
+
+    // The dot product with the weights rounds K times more, relative to
+    // the values themselves.
+    const double u = DBL_EPSILON/2;
+    const double dot_error = (parts.size() + 1)*u/(1 - (parts.size() + 1)*u);
+    for (unsigned int k = 0; k < parts.size(); k++)
+    {
+        double* term = out + k*n;
+        double error = evalUniformGrid(fixed_coefficients[k].data(), degree, x_min, x_step, nx, y_min, y_step, ny, term);
+        double max_abs_value = 0;
+        for (int p = 0; p < n; p++)
+            max_abs_value = std::max(max_abs_value, std::abs(term[p]));
+        errors[k] = (1 + dot_error)*(error + chartingError(k, max_abs_x, max_abs_y) + dot_error*max_abs_value);
+    }
+}
+
+double STDecomposition::chartingError(int k, double max_abs_x, double max_abs_y) const
+{
+    // f_k is homogeneous, so |f_k| composed with |chart| is at most the sum
+    // of its |coefficients| times the largest |form| to the degree.
+    double reach = 0;
+    for (int v = 0; v < 3; v++)
+        reach = std::max(reach, std::abs(chart[v][0])*max_abs_x + std::abs(chart[v][1])*max_abs_y + std::abs(chart[v][2]));
+    return charting_error*absolute_sums[k]*powi(reach, degree);
+}
+
+double STDecomposition::errorBound(int k, double max_abs_x, double max_abs_y) const
+{
+    // Evaluating the bound rounds too, so it gets the factor again.
+    double evaluation = evaluation_error*absolute_terms[k].eval(max_abs_x, max_abs_y, 1, 0, 0);
+    return (1 + evaluation_error)*(evaluation + chartingError(k, max_abs_x, max_abs_y));
+}
+
+double STDecomposition::evalPrecise(double x, double y, const double* w) const
+{
+    DoubleDouble point[3];
+    for (int v = 0; v < 3; v++)
+        point[v] = two_prod(chart[v][0], x) + two_prod(chart[v][1], y) + DoubleDouble(chart[v][2]);
+
+    DoubleDouble f(0);
+    for (unsigned int k = 0; k < parts.size(); k++)
+        f = f + parts[k].evalDoubleDouble(point[0], point[1], point[2], 0, 0)*DoubleDouble(w[k]);
+    return f.hi;
+}
+
+void STDecomposition::evalWithGradient(const double* x, const double* y, const double* w,
+                                       double* f, double* df_dx, double* df_dy, int n) const
+{
+    // f is linear in the coefficients, so its own are summed up once, and
+    // each point costs a single evaluation.
+    static thread_local std::vector<double> coefficients;
+    coefficients.assign(fixed_coefficients[0].size(), 0);
+    for (unsigned int k = 0; k < parts.size(); k++)
+        for (unsigned int c = 0; c < coefficients.size(); c++)
+            coefficients[c] += w[k]*fixed_coefficients[k][c];
+
+    for (int p = 0; p < n; p++)
+        ::evalWithGradient(coefficients.data(), degree, x[p], y[p], &f[p], &df_dx[p], &df_dy[p]);
+}
+
+const char* STDecomposition::backend() const
+{
+    return degree >= MIN_GRID_DEGREE ? "grid" : "fixed degree";
+}
@@ -0,0 +1,121 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef STDECOMPOSITION_H
+#define STDECOMPOSITION_H
+
+#include <vector>
+
+#include "term.h"
+#include "polynomial.h"
+#include "fixeddegree.h"
+#include "gridevaluator.h"
+
+// The highest degree of f that is charted. setChart runs on every pan and
+// zoom, and costs about degree^4 (Polynomial::onChart): some 0.1 s here, but
+// 28 s at degree 400. Curves with a factor above it are refused.
+const int MAX_CHART_DEGREE = 100;
+
+// A function split as f = sum over k of s^i_k t^j_k f_k(x, y, z).
+// The f_k don't depend on [s:t], so their values at a sample point can be
+// computed once and reused for every frame of the animation, or for every
+// member of a pencil of curves; f itself is then a dot product of those
+// values with weights().
+//
+// The f_k are evaluated on an affine chart: setChart composes them with a
+// linear map, and from then on they are polynomials in x and y alone,
+// evaluated at (x, y, 1). From MIN_GRID_DEGREE up that is done a row of a
+// grid at a time by the grid evaluator; below it, by the FixedDegree
+// evaluator for the degree of f.
+//
+// Everything but setChart is const and re-entrant, so between
+// changes of chart any number of threads can evaluate the same
+// decomposition.
+class STDecomposition
+{
+public:
+    // The chart starts out as z = 1.
+    STDecomposition(const Polynomial& f);
+    ~STDecomposition();
+
+    int numTerms() const { return parts.size(); }
+
+    // The weights s^i_k t^j_k, one per term.
+    void weights(double s, double t, double* w) const;
+
+    // Recharts every f_k as f_k(map*(x, y, 1)), as for Polynomial::onChart.
+    // Scaling the first two columns of map to the view keeps the chart's
+    // coordinates of order 1 however far in it zooms.
+    void setChart(const double map[3][3]);
+
+    // Evaluates every f_k on the chart at the nx by ny grid of points
+    // (x_min + i*x_step, y_min + j*y_step), writing f_k at (i, j) to
+    // out[k*nx*ny + i*ny + j], and a bound as for errorBound on the error of
+    // any of them to errors[k]. From MIN_GRID_DEGREE up this restricts each
+    // f_k to the rows of the grid, which costs far less than evaluating it
+    // point by point.
+    void evalTermsGrid(double x_min, double x_step, int nx, double y_min, double y_step, int ny,
+                       double* out, double* errors) const;
+
+    // Bounds f_k on the chart over the box x by y.
+    Interval boundTerm(int k, const Interval& x, const Interval& y) const;
+
+    // Bounds the difference between what evalTermsBatch gives for f_k and
+    // its exact value at any point (x, y) with |x| <= max_abs_x and
+    // |y| <= max_abs_y, counting the rounding in setChart. The error of
+    // f = sum of w_k f_k as a dot product is within sum of |w_k| times these.
+    double errorBound(int k, double max_abs_x, double max_abs_y) const;
+
+    // f = sum of w_k f_k at (x, y) on the chart, computed in double-double
+    // from the f_k before charting, whose coefficients are exact. Much
+    // slower than evalTermsGrid, but its sign is right wherever that one's
+    // is in doubt.
+    double evalPrecise(double x, double y, const double* w) const;
+
+    // f = sum of w_k f_k and its partial derivatives in the chart's x and
+    // y, at n points, in doubles.
+    void evalWithGradient(const double* x, const double* y, const double* w,
+                          double* f, double* df_dx, double* df_dy, int n) const;
+
+    // What evalTermsGrid runs for this degree: the grid evaluator or the
+    // FixedDegree one.
+    const char* backend() const;
+
+private:
+    STDecomposition(const STDecomposition&);
+    STDecomposition& operator=(const STDecomposition&);
+
+    void clearChart();
+    // Evaluates every f_k on the chart at n points, writing f_k at point p
+    // to out[k*n + p], with fixed_batch. Only for degrees below
+    // MIN_GRID_DEGREE, which all have one.
+    void evalTermsBatch(const double* x, const double* y, double* out, int n) const;
+    double chartingError(int k, double max_abs_x, double max_abs_y) const;
+
+    std::vector<int> s_exponents;
+    std::vector<int> t_exponents;
+    std::vector<Polynomial> parts; // The f_k themselves.
+    FixedDegreeBatch fixed_batch; // 0 if the degree of f is too high.
+    int degree;
+
+    // The f_k on the current chart.
+    double chart[3][3];
+    TermArena arena;
+    std::vector<Term*> terms; // For interval bounds. Lives in arena.
+    std::vector<std::vector<double> > fixed_coefficients; // For fixed_batch, evalTermsGrid and evalWithGradient.
+
+    // For errorBound: the charted |f_k|, the sums of |coefficients| of the
+    // f_k, and the relative error of one rounding chain in evaluating and in
+    // charting.
+    std::vector<Polynomial> absolute_terms;
+    std::vector<double> absolute_sums;
+    double evaluation_error;
+    double charting_error;
+};
+
+#endif // STDECOMPOSITION_H
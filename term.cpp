@@ -11,7 +11,11 @@
 #include "numericalterm.h"
 #include "variable.h"
 #include "binaryop.h"
+#include "polynomial.h"
+#include "factorization.h"
 #include <iostream>
+#include <climits>
+#include <cstdlib>
 
 bool is_num(char c)
 {
@@ -28,226 +32,192 @@ bool is_op(char c)
     return c == '+' || c == '-' || c == '*' || c == '^';
 }
 
-// Advances i to the next non-space character in input,
-// or to the end of the string.
-// Returns true if i is at a non-space character after function call,
-// returns false if i is at the end of the string.
-bool next_nonspace(std::string* input, unsigned int* i)
+// Precedence climbing over the input in place. Each character is looked at
+// a constant number of times and nothing is copied, so parsing is linear in
+// the length of the input.
+struct Parser
 {
-    while(*i < input->length())
-    {
-        char c = (*input)[*i];
-        if (!isspace(c))
-            return true;
-        (*i) += 1;
-    }
-    return false;
-}
+    const char* pos;
+    const char* end;
+    TermArena* arena;
+    int depth; // Of parentheses and exponents, to keep the stack bounded.
 
-Term* parse_atomic_term(std::string* input, unsigned int* i)
-{
-    if (!next_nonspace(input, i))
-        throw BadTermException("Expected Term.");
+    static const int MAX_DEPTH = 10000;
 
-    // Hack for unary minus.
-    if ((*input)[*i] == '-')
+    // Advances to the next non-space character. Returns false at the end.
+    bool skipSpace()
     {
-        *i += 1;
-        return new BinaryOp(BinaryOp::OP_MINUS, new NumericalTerm(0), parse_atomic_term(input, i));
+        while (pos != end && isspace((unsigned char)*pos))
+            pos++;
+        return pos != end;
     }
 
-    if (is_num((*input)[*i]))
+    void enter()
     {
+        if (++depth > MAX_DEPTH)
+            throw BadTermException("Expression nested too deeply.");
+    }
 
-        int num_so_far = (*input)[*i] - '0';
-        *i += 1;
-        for (; *i < input->length() && is_num((*input)[*i]); (*i)++)
+    // The value of the run of digits at pos. Exact while it fits in a
+    // double's 53 bit mantissa; longer literals are correctly rounded.
+    double parseNumber()
+    {
+        const char* start = pos;
+        double num_so_far = 0;
+        bool exact = true;
+        for (; pos != end && is_num(*pos); pos++)
         {
-            num_so_far = ((*input)[*i] - '0') + num_so_far*10;
+            num_so_far = num_so_far*10 + (*pos - '0');
+            if (num_so_far >= 9007199254740992.0) // 2^53
+                exact = false;
         }
-        return new NumericalTerm(num_so_far);
+        if (exact)
+            return num_so_far;
+        return strtod(std::string(start, pos).c_str(), 0);
     }
-    else if (is_var((*input)[*i]))
+
+    Term* parseAtomic()
     {
-        switch ((*input)[*i])
+        if (!skipSpace())
+            throw BadTermException("Expected Term.");
+
+        char c = *pos;
+
+        // Hack for unary minus. It binds tighter than anything, so -x^2 is (-x)^2.
+        if (c == '-')
         {
-        case 'x':
-            (*i) += 1;
-            return new Variable(Variable::VAR_X);
-        case 'y':
-            (*i) += 1;
-            return new Variable(Variable::VAR_Y);
-        case 'z':
-            (*i) += 1;
-            return new Variable(Variable::VAR_Z);
-        case 's':
-            (*i) += 1;
-            return new Variable(Variable::VAR_S);
-        case 't':
-            (*i) += 1;
-            return new Variable(Variable::VAR_T);
+            pos++;
+            enter();
+            Term* negated = parseAtomic();
+            depth--;
+            return new (arena) BinaryOp(BinaryOp::OP_MINUS, new (arena) NumericalTerm(0), negated);
         }
-    }
-    else if ((*input)[*i] == '(')
-    {
-        int paren_count = 1;
-        for (unsigned int j = *i + 1; j < input->length(); j++)
+
+        if (is_num(c))
+            return new (arena) NumericalTerm(parseNumber());
+
+        if (is_var(c))
         {
-            if ((*input)[j] == '(')
-                paren_count += 1;
-            else if ((*input)[j] == ')')
+            pos++;
+            switch (c)
             {
-                paren_count -= 1;
-                if (paren_count == 0)
-                {
-                    std::string between_parens;
-                    between_parens = input->substr(*i + 1, j - *i - 1);
-                    *i = j + 1;
-                    Term* parened_term = Term::parseTerm(between_parens);
-                    return parened_term;
-                }
-                else if (paren_count < 0)
-                    throw BadTermException("Too many closing parentheses.");
+            case 'x':
+                return new (arena) Variable(Variable::VAR_X);
+            case 'y':
+                return new (arena) Variable(Variable::VAR_Y);
+            case 'z':
+                return new (arena) Variable(Variable::VAR_Z);
+            case 's':
+                return new (arena) Variable(Variable::VAR_S);
+            default:
+                return new (arena) Variable(Variable::VAR_T);
             }
         }
-        throw BadTermException("Unclosed parenthesis.");
-
-    }
-    throw BadTermException("Unexpected character.");
-}
 
-BinaryOp::op_type get_op(std::string* input, unsigned int* i)
-{
-    if (!next_nonspace(input, i))
-        throw BadTermException("Expected operator.");
+        if (c == '(')
+        {
+            pos++;
+            enter();
+            Term* parened_term = parseExpression(0);
+            depth--;
+            if (!skipSpace() || *pos != ')')
+                throw BadTermException("Unclosed parenthesis.");
+            pos++;
+            return parened_term;
+        }
 
-    char c = (*input)[*i];
-    if (c == '+')
-    {
-        (*i) += 1;
-        return BinaryOp::OP_PLUS;
-    }
-    else if (c == '-')
-    {
-        (*i) += 1;
-        return BinaryOp::OP_MINUS;
-    }
-    else if (c == '*')
-    {
-        (*i) += 1;
-        return BinaryOp::OP_TIMES;
-    }
-    else if (is_num(c) || is_var(c) || c == '(')
-        return BinaryOp::OP_TIMES;
-    else if (c == '^')
-    {
-        (*i) += 1;
-        return BinaryOp::OP_EXP;
+        throw BadTermException("Unexpected character.");
     }
 
-    throw BadTermException("Expected operator.");
-}
+    // Reads the operator at pos, which must not be the end of the input.
+    // Juxtaposition is multiplication, so nothing is consumed when the next
+    // character starts a term.
+    BinaryOp::op_type peekOp(int* length)
+    {
+        *length = 1;
+        switch (*pos)
+        {
+        case '+':
+            return BinaryOp::OP_PLUS;
+        case '-':
+            return BinaryOp::OP_MINUS;
+        case '*':
+            return BinaryOp::OP_TIMES;
+        case '^':
+            return BinaryOp::OP_EXP;
+        }
 
-void tokenize(std::string* input, std::vector<Term*>* terms, std::vector<BinaryOp::op_type>* ops)
-{
-    unsigned int i = 0;
+        if (is_num(*pos) || is_var(*pos) || *pos == '(')
+        {
+            *length = 0;
+            return BinaryOp::OP_TIMES;
+        }
 
-    for (;;)
-    {
-        Term* next_term = parse_atomic_term(input, &i);
-        terms->push_back(next_term);
-        if (!next_nonspace(input, &i)) // If final term, leave.
-            return;
-        BinaryOp::op_type next_op = get_op(input, &i);
-        ops->push_back(next_op);
+        throw BadTermException("Expected operator.");
     }
-}
 
-void build_exponents(std::vector<Term*>* terms, std::vector<BinaryOp::op_type>* ops)
-{
-    // Right to left for right associativity.
-    for (int i = ops->size() - 1; i >= 0; i--)
+    // Parses operators of priority at least min_priority and their operands.
+    // +, - and * associate to the left, ^ to the right.
+    Term* parseExpression(int min_priority)
     {
-        if ((*ops)[i] == BinaryOp::OP_EXP)
-        {
-            if (!(*terms)[i + 1]->isNumerical())
-            {
-                throw BadTermException("Variables not allowed in exponents.");
-            }
+        Term* lhs = parseAtomic();
 
-            if ((*terms)[i + 1]->eval(0,0,0,0,0) < 0)
+        while (skipSpace() && *pos != ')')
+        {
+            int length;
+            BinaryOp::op_type op = peekOp(&length);
+            int priority = BinaryOp::op_priority(op);
+            if (priority < min_priority)
+                break;
+            pos += length;
+
+            if (op == BinaryOp::OP_EXP)
             {
-                throw BadTermException("Negative exponents not allowed.");
+                enter();
+                Term* exponent = parseExpression(priority);
+                depth--;
+
+                if (!exponent->isNumerical())
+                    throw BadTermException("Variables not allowed in exponents.");
+                double value = exponent->eval(0,0,0,0,0);
+                if (value < 0)
+                    throw BadTermException("Negative exponents not allowed.");
+                if (value > INT_MAX)
+                    throw BadTermException("Exponent too large.");
+
+                lhs = new (arena) BinaryOp(op, lhs, exponent);
             }
-
-            Term* rhs = (*terms)[i + 1];
-            Term* lhs = (*terms)[i];
-
-            Term* combined = new BinaryOp(BinaryOp::OP_EXP, lhs, rhs);
-
-            terms->erase(terms->begin() + i, terms->begin() + i + 2);
-            terms->insert(terms->begin() + i, combined);
-            ops->erase(ops->begin() + i);
+            else
+                lhs = new (arena) BinaryOp(op, lhs, parseExpression(priority + 1));
         }
+
+        return lhs;
     }
-}
+};
 
-void build_multiplication(std::vector<Term*>* terms, std::vector<BinaryOp::op_type>* ops)
+Term* Term::parseTerm(const std::string& input, TermArena* arena)
 {
-    // Left to right for left associativity.
-    for (unsigned int i = 0; i < ops->size();)
-    {
-        if ((*ops)[i] == BinaryOp::OP_TIMES)
-        {
-            Term* rhs = (*terms)[i + 1];
-            Term* lhs = (*terms)[i];
+    Parser parser = { input.data(), input.data() + input.size(), arena, 0 };
+    Term* result = parser.parseExpression(0);
 
-            Term* combined = new BinaryOp(BinaryOp::OP_TIMES, lhs, rhs);
+    // parseExpression only stops early at a closing parenthesis.
+    if (parser.skipSpace())
+        throw BadTermException("Too many closing parentheses.");
 
-            terms->erase(terms->begin() + i, terms->begin() + i + 2);
-            terms->insert(terms->begin() + i, combined);
-            ops->erase(ops->begin() + i);
-        }
-        else
-            i++;
-    }
+    return result;
 }
 
-void build_addition_subtraction(std::vector<Term*>* terms, std::vector<BinaryOp::op_type>* ops)
+void Term::addFactors(int multiplicity, std::vector<Factor>* factors)
 {
-    // Left to right for left associativity.
-    for (unsigned int i = 0; i < ops->size();)
-    {
-        if ((*ops)[i] == BinaryOp::OP_PLUS || (*ops)[i] == BinaryOp::OP_MINUS)
-        {
-            Term* rhs = (*terms)[i + 1];
-            Term* lhs = (*terms)[i];
-
-            Term* combined = new BinaryOp((*ops)[i], lhs, rhs);
-
-            terms->erase(terms->begin() + i, terms->begin() + i + 2);
-            terms->insert(terms->begin() + i, combined);
-            ops->erase(ops->begin() + i);
-        }
-        else
-            i++;
-    }
+    Factor factor = { toPolynomial(), multiplicity };
+    factors->push_back(factor);
 }
 
-Term* Term::parseTerm(std::string input)
+Term* Term::homogenize(int* degree, TermArena* arena)
 {
-    std::vector<Term*> terms;
-    std::vector<BinaryOp::op_type> ops;
-
-    tokenize(&input, &terms, &ops); // Handles parentheses.
-
-    build_exponents(&terms, &ops);
-    build_multiplication(&terms, &ops);
-    // No division allowed.
-    build_addition_subtraction(&terms, &ops);
-
-    if (terms.size() != 1)
-        throw BadTermException("Parser error.");
-
-    return terms[0];
+    // Working on the expanded form means cancellation is accounted for;
+    // x^2 - x^2 + x has degree 1, not 2.
+    Polynomial homogenized = Polynomial(this).homogenize();
+    *degree = homogenized.degree();
+    return homogenized.toTerm(arena);
 }
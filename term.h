@@ -11,6 +11,14 @@
 
 #include <qstring.h>
 #include <QVector4D>
+#include <vector>
+
+#include "termarena.h"
+#include "interval.h"
+
+class Polynomial;
+class TermTable;
+struct Factor;
 
 class Term
 {
@@ -18,28 +26,56 @@ public:
     Term(){}
     virtual ~Term() {}
 
-    // Warning: allocates a new Term.
-    static Term* parseTerm(std::string input);
-    virtual double eval(double x, double y, double z, double s, double t) = 0;
-    double eval(QVector4D v, double s, double t) { return eval(v.x(), v.y(), v.z(), s, t); }
+    // Terms are made in a TermArena, as in new (arena) Variable(...),
+    // and are freed all at once along with it, never one at a time.
+    static void* operator new(size_t size, TermArena* arena) { return arena->allocate(size); }
+    static void operator delete(void*, TermArena*) {}
+
+    // Allocates the result in arena.
+    static Term* parseTerm(const std::string& input, TermArena* arena);
+    virtual double eval(double x, double y, double z, double s, double t) const = 0;
+    double eval(QVector4D v, double s, double t) const { return eval(v.x(), v.y(), v.z(), s, t); }
+    // Bounds this term over the box x by y by z. The true range of values
+    // lies inside the result, though it may be much smaller.
+    virtual Interval evalInterval(const Interval& x, const Interval& y, const Interval& z, double s, double t) const = 0;
     int priority() { return my_priority; }
     void setPriority(int priority) { my_priority = priority; }
 
-    // Warning: allocates a new Term.
-    virtual Term* derivative(char var) = 0;
+    // Allocates the result in arena. It shares nodes with this term rather
+    // than copying them, so it must not outlive this term's arena.
+    virtual Term* derivative(char var, TermArena* arena) = 0;
     virtual void print() = 0;
-    virtual Term* Clone() = 0;
+    // Allocates the result in arena.
+    virtual Term* Clone(TermArena* arena) = 0;
 
-    // Warning: allocates a new Term.
-    virtual Term* simplify() { return Clone(); }
-    // Warning: allocates a new Term.
-    virtual Term* homogenize(int* degree) = 0;
+    // Allocates the result in arena.
+    virtual Term* simplify(TermArena* arena) { return Clone(arena); }
+    // Multiplies terms by powers of z so that every monomial has the same
+    // degree in x, y and z. That degree is written to degree.
+    // Allocates the result in arena.
+    Term* homogenize(int* degree, TermArena* arena);
+    // Expands this term into canonical form.
+    virtual Polynomial toPolynomial() = 0;
+    // Appends the factors this term was written as a product of, raised to
+    // multiplicity, without expanding the product.
+    virtual void addFactors(int multiplicity, std::vector<Factor>* factors);
+    // Returns the node of table equal to this term.
+    virtual Term* intern(TermTable* table) = 0;
+    // Size of this term as a tree.
+    virtual int numNodes() { return 1; }
 
     virtual bool isZero() { return false; }
     virtual bool isOne() { return false; }
     virtual bool isNumerical() { return false; }
+    // Whether this is a BinaryOp adding or subtracting.
+    virtual bool isSum() { return false; }
+    // Whether this is a BinaryOp multiplying or raising to a power.
+    virtual bool isProduct() { return false; }
 protected:
     int my_priority = 0;
+
+    // Only here for the virtual destructors; Terms are never deleted.
+    static void operator delete(void*) {}
 };
 
 class BadTermException
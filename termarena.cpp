@@ -0,0 +1,56 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "termarena.h"
+
+TermArena::~TermArena()
+{
+    for (unsigned int i = 0; i < blocks.size(); i++)
+        delete[] blocks[i].data;
+}
+
+void* TermArena::allocate(size_t size)
+{
+    // Keep every node aligned for doubles and pointers.
+    const size_t alignment = sizeof(double) > sizeof(void*) ? sizeof(double) : sizeof(void*);
+    size = (size + alignment - 1) & ~(alignment - 1);
+
+    if (blocks.empty() || used + size > blocks.back().size)
+    {
+        // Each block is twice the last, so n nodes take O(log n) heap allocations.
+        size_t block_size = blocks.empty() ? FIRST_BLOCK_SIZE : 2*blocks.back().size;
+        if (block_size < size)
+            block_size = size;
+
+        Block block = { new char[block_size], block_size };
+        blocks.push_back(block);
+        num_heap_allocations++;
+        used = 0;
+    }
+
+    void* result = blocks.back().data + used;
+    used += size;
+    num_nodes++;
+    return result;
+}
+
+void TermArena::reset()
+{
+    if (!blocks.empty())
+    {
+        // The last block is always the largest.
+        Block largest = blocks.back();
+        for (unsigned int i = 0; i + 1 < blocks.size(); i++)
+            delete[] blocks[i].data;
+        blocks.clear();
+        blocks.push_back(largest);
+    }
+
+    used = 0;
+    num_nodes = 0;
+}
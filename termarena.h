@@ -0,0 +1,55 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef TERMARENA_H
+#define TERMARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// A bump allocator for Terms. Nodes are carved out of large blocks one
+// after another, so an expression sits contiguously in memory, and the
+// whole lot is released at once when the arena is reset or destroyed.
+// Destructors of the nodes are never run; Terms own nothing but memory
+// in their arena.
+class TermArena
+{
+public:
+    TermArena() {}
+    ~TermArena();
+
+    void* allocate(size_t size);
+
+    // Releases every node at once. The largest block is kept for reuse,
+    // so an arena that is reset and refilled stops touching the heap.
+    void reset();
+
+    int numNodes() { return num_nodes; }
+    int numBlocks() { return blocks.size(); }
+    // Blocks requested from the heap since the arena was created.
+    int numHeapAllocations() { return num_heap_allocations; }
+
+private:
+    TermArena(const TermArena&);
+    TermArena& operator=(const TermArena&);
+
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+
+    static const size_t FIRST_BLOCK_SIZE = 4096;
+
+    std::vector<Block> blocks;
+    size_t used = 0; // Bytes taken in the last block.
+    int num_nodes = 0;
+    int num_heap_allocations = 0;
+};
+
+#endif // TERMARENA_H
@@ -0,0 +1,256 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "termtable.h"
+
+#include <cstring>
+
+#include "numericalterm.h"
+#include "compiledterm.h"
+
+size_t TermTable::NodeHash::operator()(const Node& n) const
+{
+    // -0.0 == 0.0, as Node compares them, so they must hash alike too.
+    double val = n.val == 0 ? 0.0 : n.val;
+    long long val_bits;
+    memcpy(&val_bits, &val, sizeof(val_bits));
+
+    size_t h = n.kind*31 + n.op;
+    h = h*1000003 ^ std::hash<long long>()(val_bits);
+    h = h*1000003 ^ std::hash<Term*>()(n.lhs);
+    h = h*1000003 ^ std::hash<Term*>()(n.rhs);
+    return h;
+}
+
+Term* TermTable::findOrAdd(const Node& node)
+{
+    std::unordered_map<Node, Term*, NodeHash>::iterator found = index.find(node);
+    if (found != index.end())
+        return found->second;
+
+    Term* term;
+    switch (node.kind)
+    {
+    case NODE_VARIABLE:
+        term = new (&arena) Variable((Variable::var_type)node.op);
+        break;
+    case NODE_NUMBER:
+        term = new (&arena) NumericalTerm(node.val);
+        break;
+    case NODE_BINARY_OP:
+    default:
+        term = new (&arena) BinaryOp((BinaryOp::op_type)node.op, node.lhs, node.rhs);
+        break;
+    }
+
+    index[node] = term;
+    nodes[term] = node;
+    return term;
+}
+
+const TermTable::Node& TermTable::nodeOf(Term* f)
+{
+    std::unordered_map<Term*, Node>::iterator found = nodes.find(f);
+    if (found == nodes.end())
+        throw BadTermException("Term does not belong to this table.");
+    return found->second;
+}
+
+Term* TermTable::intern(Term* f)
+{
+    return f->intern(this);
+}
+
+Term* TermTable::variable(Variable::var_type var)
+{
+    Node node = { NODE_VARIABLE, var, 0, 0, 0 };
+    return findOrAdd(node);
+}
+
+Term* TermTable::number(double val)
+{
+    Node node = { NODE_NUMBER, 0, val, 0, 0 };
+    return findOrAdd(node);
+}
+
+Term* TermTable::binaryOp(BinaryOp::op_type op, Term* lhs, Term* rhs)
+{
+    const Node& l = nodeOf(lhs);
+    const Node& r = nodeOf(rhs);
+    bool l_num = l.kind == NODE_NUMBER;
+    bool r_num = r.kind == NODE_NUMBER;
+
+    switch (op)
+    {
+    case BinaryOp::OP_PLUS:
+        if (l_num && r_num)
+            return number(l.val + r.val);
+        if (l_num && l.val == 0)
+            return rhs;
+        if (r_num && r.val == 0)
+            return lhs;
+        break;
+    case BinaryOp::OP_MINUS:
+        if (l_num && r_num)
+            return number(l.val - r.val);
+        if (r_num && r.val == 0)
+            return lhs;
+        if (lhs == rhs)
+            return number(0);
+        break;
+    case BinaryOp::OP_TIMES:
+        if (l_num && r_num)
+            return number(l.val * r.val);
+        if ((l_num && l.val == 0) || (r_num && r.val == 0))
+            return number(0);
+        if (l_num && l.val == 1)
+            return rhs;
+        if (r_num && r.val == 1)
+            return lhs;
+        break;
+    case BinaryOp::OP_EXP:
+        if (!r_num)
+            throw BadTermException("Variables not allowed in exponents.");
+        if (l_num)
+            return number(powi(l.val, (int)r.val));
+        if (r.val == 0)
+            return number(1);
+        if (r.val == 1)
+            return lhs;
+        break;
+    }
+
+    Node node = { NODE_BINARY_OP, op, 0, lhs, rhs };
+    return findOrAdd(node);
+}
+
+Term* TermTable::derivative(Term* f, char var)
+{
+    std::pair<Term*, char> key(f, var);
+    std::map<std::pair<Term*, char>, Term*>::iterator found = derivatives.find(key);
+    if (found != derivatives.end())
+        return found->second;
+
+    Node node = nodeOf(f);
+    Term* result = 0;
+
+    switch (node.kind)
+    {
+    case NODE_VARIABLE:
+        // As in Variable::derivative, s and t are treated as constants.
+        if ((node.op == Variable::VAR_X && var == 'x') ||
+            (node.op == Variable::VAR_Y && var == 'y') ||
+            (node.op == Variable::VAR_Z && var == 'z'))
+            result = number(1);
+        else
+            result = number(0);
+        break;
+    case NODE_NUMBER:
+        result = number(0);
+        break;
+    case NODE_BINARY_OP:
+        switch (node.op)
+        {
+        case BinaryOp::OP_PLUS:
+        case BinaryOp::OP_MINUS:
+            result = binaryOp((BinaryOp::op_type)node.op, derivative(node.lhs, var), derivative(node.rhs, var));
+            break;
+        case BinaryOp::OP_TIMES:
+            // Product rule, with both factors shared rather than cloned.
+            result = binaryOp(BinaryOp::OP_PLUS,
+                              binaryOp(BinaryOp::OP_TIMES, derivative(node.lhs, var), node.rhs),
+                              binaryOp(BinaryOp::OP_TIMES, node.lhs, derivative(node.rhs, var)));
+            break;
+        case BinaryOp::OP_EXP:
+        {
+            // Power rule. Exponents are always numbers in the table.
+            double exponent = nodeOf(node.rhs).val;
+            Term* lowered = binaryOp(BinaryOp::OP_EXP, node.lhs, number(exponent - 1));
+            result = binaryOp(BinaryOp::OP_TIMES,
+                              binaryOp(BinaryOp::OP_TIMES, node.rhs, derivative(node.lhs, var)),
+                              lowered);
+            break;
+        }
+        }
+        break;
+    }
+
+    derivatives[key] = result;
+    return result;
+}
+
+// Lists the nodes reachable from f with operands before their users,
+// counting how many times each node is used as an operand.
+void TermTable::postOrder(Term* f, std::unordered_map<Term*, int>* uses, std::vector<Term*>* order)
+{
+    std::unordered_map<Term*, int>::iterator found = uses->find(f);
+    if (found != uses->end())
+    {
+        found->second++;
+        return;
+    }
+
+    (*uses)[f] = 1;
+    const Node& node = nodeOf(f);
+    if (node.kind == NODE_BINARY_OP)
+    {
+        postOrder(node.lhs, uses, order);
+        if (node.op != BinaryOp::OP_EXP)
+            postOrder(node.rhs, uses, order);
+    }
+    order->push_back(f);
+}
+
+int TermTable::numNodes(Term* f)
+{
+    std::unordered_map<Term*, int> uses;
+    std::vector<Term*> order;
+    postOrder(f, &uses, &order);
+    return order.size();
+}
+
+int TermTable::compile(Term* f, CompiledTerm* program)
+{
+    std::unordered_map<Term*, int> uses;
+    std::vector<Term*> order;
+    postOrder(f, &uses, &order);
+
+    std::unordered_map<Term*, int> registers;
+    for (unsigned int i = 0; i < order.size(); i++)
+    {
+        const Node& node = nodeOf(order[i]);
+        int reg;
+        switch (node.kind)
+        {
+        case NODE_VARIABLE:
+            reg = program->emitLoadVar(node.op);
+            break;
+        case NODE_NUMBER:
+            reg = program->emitLoadConst(node.val);
+            break;
+        case NODE_BINARY_OP:
+        default:
+            if (node.op == BinaryOp::OP_EXP)
+                reg = program->emitPowi(registers[node.lhs], (int)nodeOf(node.rhs).val);
+            else
+            {
+                CompiledTerm::opcode op = node.op == BinaryOp::OP_PLUS ? CompiledTerm::OP_ADD :
+                                          node.op == BinaryOp::OP_MINUS ? CompiledTerm::OP_SUB :
+                                                                           CompiledTerm::OP_MUL;
+                reg = program->emitBinary(op, registers[node.lhs], registers[node.rhs]);
+            }
+            break;
+        }
+
+        // Keep the value around until its last user has read it.
+        program->retainRegister(reg, uses[order[i]] - 1);
+        registers[order[i]] = reg;
+    }
+
+    return registers[f];
+}
@@ -0,0 +1,86 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef TERMTABLE_H
+#define TERMTABLE_H
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "term.h"
+#include "binaryop.h"
+#include "variable.h"
+#include "termarena.h"
+
+class CompiledTerm;
+
+// A hash-consing table for Terms. Every node made through the table is
+// unique up to structure, so equal subexpressions are one shared node and
+// a term stored here is a DAG rather than a tree.
+// The table's nodes live in its own arena and are freed along with it.
+class TermTable
+{
+public:
+    TermTable() {}
+
+    // Returns the table's copy of f. f itself is left alone.
+    Term* intern(Term* f);
+
+    // Node constructors. Operands must already belong to this table.
+    // binaryOp folds constants and drops identities (0 + a, 1*a, a^1, ...).
+    Term* variable(Variable::var_type var);
+    Term* number(double val);
+    Term* binaryOp(BinaryOp::op_type op, Term* lhs, Term* rhs);
+
+    // Differentiates a node of this table. The result shares structure with
+    // f, and derivatives of shared subterms are only worked out once.
+    Term* derivative(Term* f, char var);
+
+    // Number of distinct nodes reachable from f.
+    int numNodes(Term* f);
+    int size() { return nodes.size(); }
+
+    // Appends f to program so that each distinct node is computed once.
+    // Returns the register holding the result.
+    int compile(Term* f, CompiledTerm* program);
+
+private:
+    enum node_kind { NODE_VARIABLE, NODE_NUMBER, NODE_BINARY_OP };
+
+    struct Node
+    {
+        node_kind kind;
+        int op; // var_type or op_type
+        double val;
+        Term* lhs;
+        Term* rhs;
+
+        bool operator==(const Node& other) const
+        {
+            return kind == other.kind && op == other.op && val == other.val
+                && lhs == other.lhs && rhs == other.rhs;
+        }
+    };
+
+    struct NodeHash
+    {
+        size_t operator()(const Node& n) const;
+    };
+
+    Term* findOrAdd(const Node& node);
+    const Node& nodeOf(Term* f);
+    void postOrder(Term* f, std::unordered_map<Term*, int>* uses, std::vector<Term*>* order);
+
+    TermArena arena;
+    std::unordered_map<Node, Term*, NodeHash> index;
+    std::unordered_map<Term*, Node> nodes;
+    std::map<std::pair<Term*, char>, Term*> derivatives;
+};
+
+#endif // TERMTABLE_H
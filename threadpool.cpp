@@ -0,0 +1,87 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int num_threads) : next_index(0)
+{
+    if (num_threads < 1)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (int thread = 1; thread < num_threads; thread++)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, thread));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (unsigned int i = 0; i < workers.size(); i++)
+        workers[i].join();
+}
+
+void ThreadPool::run(int n, const std::function<void(int, int)>& task)
+{
+    if (n <= 0)
+        return;
+    if (workers.empty() || n == 1)
+    {
+        for (int i = 0; i < n; i++)
+            task(i, 0);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        current_task = &task;
+        current_n = n;
+        next_index = 0;
+        busy_workers = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    work(0);
+
+    // task lives on this stack frame, so every worker has to be done with
+    // it before returning.
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return busy_workers == 0; });
+    current_task = 0;
+}
+
+void ThreadPool::workerLoop(int thread)
+{
+    int seen_generation = 0;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen_generation; });
+            if (stopping)
+                return;
+            seen_generation = generation;
+        }
+
+        work(thread);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--busy_workers == 0)
+            done.notify_one();
+    }
+}
+
+void ThreadPool::work(int thread)
+{
+    for (int i = next_index++; i < current_n; i = next_index++)
+        (*current_task)(i, thread);
+}
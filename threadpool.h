@@ -0,0 +1,59 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads for parallel loops. The thread calling run
+// works alongside them, so a pool of one thread has no workers at all and
+// runs everything in place.
+class ThreadPool
+{
+public:
+    // num_threads < 1 means one per core.
+    explicit ThreadPool(int num_threads = 0);
+    ~ThreadPool();
+
+    int numThreads() const { return workers.size() + 1; }
+
+    // Calls task(i, thread) once for each i in [0, n), spread over the
+    // threads, and returns when every call has. thread is in
+    // [0, numThreads()), and no two calls with the same thread run at
+    // once, so it can index per-thread scratch space. Indices are handed
+    // out in order as threads come free, so cheap and expensive tasks
+    // balance out. run is not re-entrant.
+    void run(int n, const std::function<void(int i, int thread)>& task);
+
+private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    void workerLoop(int thread);
+    // Takes indices of the current run until there are none left.
+    void work(int thread);
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake; // Workers wait here for a run.
+    std::condition_variable done; // run waits here for the workers.
+    const std::function<void(int, int)>* current_task = 0;
+    int current_n = 0;
+    std::atomic<int> next_index;
+    int generation = 0; // Counts runs, so workers can tell a new one.
+    int busy_workers = 0;
+    bool stopping = false;
+};
+
+#endif // THREADPOOL_H
@@ -11,13 +11,15 @@
 #include <iostream>
 
 #include "numericalterm.h"
+#include "polynomial.h"
+#include "termtable.h"
 
 Variable::Variable(var_type var)
 {
     this->var = var;
 }
 
-double Variable::eval(double x, double y, double z, double s, double t)
+double Variable::eval(double x, double y, double z, double s, double t) const
 {
     switch (var)
     {
@@ -36,29 +38,48 @@ double Variable::eval(double x, double y, double z, double s, double t)
     }
 }
 
-Term* Variable::derivative(char var)
+Interval Variable::evalInterval(const Interval& x, const Interval& y, const Interval& z, double s, double t) const
+{
+    switch (var)
+    {
+    case VAR_X:
+        return x;
+    case VAR_Y:
+        return y;
+    case VAR_Z:
+        return z;
+    case VAR_S:
+        return Interval(s);
+    case VAR_T:
+        return Interval(t);
+    default:
+        throw BadTermException();
+    }
+}
+
+Term* Variable::derivative(char var, TermArena* arena)
 {
     switch (this->var)
     {
     case VAR_X:
         if (var == 'x')
-            return new NumericalTerm(1);
+            return new (arena) NumericalTerm(1);
         else
-            return new NumericalTerm(0);
+            return new (arena) NumericalTerm(0);
     case VAR_Y:
         if (var == 'y')
-            return new NumericalTerm(1);
+            return new (arena) NumericalTerm(1);
         else
-            return new NumericalTerm(0);
+            return new (arena) NumericalTerm(0);
     case VAR_Z:
         if (var == 'z')
-            return new NumericalTerm(1);
+            return new (arena) NumericalTerm(1);
         else
-            return new NumericalTerm(0);
+            return new (arena) NumericalTerm(0);
     case VAR_S:
-        return new NumericalTerm(0);
+        return new (arena) NumericalTerm(0);
     case VAR_T:
-        return new NumericalTerm(0);
+        return new (arena) NumericalTerm(0);
     default:
         throw BadTermException();
     }
@@ -86,7 +107,17 @@ void Variable::print()
     }
 }
 
-Term* Variable::Clone()
+Term* Variable::Clone(TermArena* arena)
+{
+    return new (arena) Variable(var);
+}
+
+Polynomial Variable::toPolynomial()
+{
+    return Polynomial::variable(var);
+}
+
+Term* Variable::intern(TermTable* table)
 {
-    return new Variable(var);
+    return table->variable(var);
 }
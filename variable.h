@@ -16,14 +16,14 @@ class Variable : public Term
 public:
     enum var_type { VAR_X, VAR_Y, VAR_Z, VAR_S, VAR_T };
     Variable(var_type var);
-    virtual ~Variable() {};
 
-    double virtual eval(double x, double y, double z, double s, double t);
-    virtual Term* derivative(char var);
+    double virtual eval(double x, double y, double z, double s, double t) const;
+    virtual Interval evalInterval(const Interval& x, const Interval& y, const Interval& z, double s, double t) const;
+    virtual Term* derivative(char var, TermArena* arena);
     virtual void print();
-    virtual Term* Clone();
-    virtual Term* homogenize(int* degree) { *degree = 1;
-                                            return Clone(); }
+    virtual Term* Clone(TermArena* arena);
+    virtual Polynomial toPolynomial();
+    virtual Term* intern(TermTable* table);
 private:
     var_type var;
 };
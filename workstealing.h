@@ -0,0 +1,179 @@
+/*
+    Projective Curve Viewer
+    Copyright (C) 2016  Sebastian Bozlee
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>
+ */
+
+#ifndef WORKSTEALING_H
+#define WORKSTEALING_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "threadpool.h"
+
+struct WorkerStats
+{
+    long tasks = 0; // Run by this worker.
+    long steals = 0; // Of those, how many it took from another.
+    long long busy_nsecs = 0; // Spent running tasks, not looking for them.
+};
+
+// Runs a tree of tasks on the threads of a ThreadPool, for work whose
+// size nobody knows in advance. Each worker keeps its own deque: tasks it
+// spawns go on the back, and it takes its next task from the back too, so
+// it works depth first on what it has just touched. A worker with nothing
+// left steals from the front of another's deque, where the oldest and so
+// usually biggest tasks are. Each deque has its own lock, which only its
+// owner and the odd thief ever take, so there is no lock everyone waits on.
+template <class Task>
+class WorkStealingScheduler
+{
+public:
+    explicit WorkStealingScheduler(ThreadPool* pool) : pool(pool), pending(0) {}
+
+    int numWorkers() const { return pool->numThreads(); }
+
+    // Runs the tasks of initial, and every task they spawn, and returns when
+    // all are done. execute(task, worker) is called once for each, with
+    // worker in [0, numWorkers()); no two calls with the same worker run at
+    // once, so it can index per-worker output. execute may call spawn with
+    // its own worker.
+    template <class Execute>
+    void run(const std::vector<Task>& initial, Execute execute)
+    {
+        run(initial, execute, [] {});
+    }
+
+    // As run, but the thread calling it also calls between() after each
+    // task it runs and whenever it finds none, so that thread can do work
+    // of its own, such as what only it may do, while the others go on.
+    template <class Execute, class Between>
+    void run(const std::vector<Task>& initial, Execute execute, Between between);
+
+    void spawn(int worker, const Task& task)
+    {
+        pending++;
+        Deque& deque = deques[worker];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        deque.tasks.push_back(task);
+    }
+
+    // For the last run, one per worker.
+    const std::vector<WorkerStats>& stats() const { return worker_stats; }
+
+private:
+    WorkStealingScheduler(const WorkStealingScheduler&);
+    WorkStealingScheduler& operator=(const WorkStealingScheduler&);
+
+    // A vector with its front at head, so stealing needs no shifting, and
+    // the storage is kept from run to run.
+    struct Deque
+    {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        size_t head = 0;
+    };
+
+    bool popBack(int worker, Task* task)
+    {
+        Deque& deque = deques[worker];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        if (deque.tasks.size() == deque.head)
+            return false;
+        *task = deque.tasks.back();
+        deque.tasks.pop_back();
+        if (deque.tasks.size() == deque.head)
+        {
+            deque.tasks.clear();
+            deque.head = 0;
+        }
+        return true;
+    }
+
+    bool stealFront(int victim, Task* task)
+    {
+        Deque& deque = deques[victim];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        if (deque.tasks.size() == deque.head)
+            return false;
+        *task = deque.tasks[deque.head++];
+        return true;
+    }
+
+    ThreadPool* pool;
+    std::vector<Deque> deques;
+    std::vector<WorkerStats> worker_stats;
+    std::atomic<long> pending; // Spawned tasks not yet finished.
+};
+
+template <class Task>
+template <class Execute, class Between>
+void WorkStealingScheduler<Task>::run(const std::vector<Task>& initial, Execute execute, Between between)
+{
+    const int num_workers = numWorkers();
+    if ((int)deques.size() != num_workers)
+        deques = std::vector<Deque>(num_workers);
+    worker_stats.assign(num_workers, WorkerStats());
+
+    // The initial tasks are dealt out in runs, each to the worker that
+    // would have been given it by a static split.
+    pending = initial.size();
+    for (int worker = 0; worker < num_workers; worker++)
+    {
+        Deque& deque = deques[worker];
+        deque.tasks.clear();
+        deque.head = 0;
+        size_t begin = initial.size()*worker/num_workers;
+        size_t end = initial.size()*(worker + 1)/num_workers;
+        // Reversed, so the owner starts from the front of its run.
+        for (size_t i = end; i > begin; i--)
+            deque.tasks.push_back(initial[i - 1]);
+    }
+
+    // Two pointers are as much as std::function holds without allocating,
+    // so execute and between go in one. The pool's thread 0 is the one
+    // calling run.
+    std::pair<Execute*, Between*> calls(&execute, &between);
+    pool->run(num_workers, [this, &calls](int worker, int thread)
+    {
+        const int num_workers = deques.size();
+        WorkerStats& stats = worker_stats[worker];
+        Task task;
+        while (pending > 0)
+        {
+            bool found = popBack(worker, &task);
+            for (int i = 1; !found && i < num_workers; i++)
+            {
+                found = stealFront((worker + i) % num_workers, &task);
+                if (found)
+                    stats.steals++;
+            }
+            if (!found)
+            {
+                // Whatever is left is running elsewhere, and may yet spawn.
+                if (thread == 0)
+                    (*calls.second)();
+                std::this_thread::yield();
+                continue;
+            }
+
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            (*calls.first)(task, worker);
+            stats.busy_nsecs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - start).count();
+            stats.tasks++;
+            pending--;
+            if (thread == 0)
+                (*calls.second)();
+        }
+    });
+}
+
+#endif // WORKSTEALING_H